@@ -0,0 +1,48 @@
+/*
+ * Copyright (c) 2012 Daniel Loffgren
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <assert.h>
+
+#include "atoms.h"
+
+static Atom atoms[AtomCount];
+
+static char *atomNames[AtomCount] = {
+	"WM_PROTOCOLS",
+	"WM_DELETE_WINDOW",
+	"WM_TAKE_FOCUS",
+	"_NET_WM_NAME",
+	"UTF8_STRING",
+	"_NET_WM_SYNC_REQUEST",
+	"_NET_WM_SYNC_REQUEST_COUNTER",
+};
+
+void internAtoms(Display *display) {
+	int ok = XInternAtoms(display, atomNames, AtomCount, False, atoms);
+	assert(ok);
+	(void)ok;
+}
+
+Atom atomNamed(AtomName name) {
+	assert(atoms[name] != None);
+	return atoms[name];
+}
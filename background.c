@@ -0,0 +1,102 @@
+/*
+ * Copyright (c) 2012 Daniel Loffgren
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <X11/Xlib.h>
+
+#include "background.h"
+#include "decorations.h"
+#include "resources.h"
+
+static int enabled;
+static int depth;
+static Pixmap resizerBackground;    /* the same for every frame */
+
+void enableFrameBackgrounds(Display *display, int screen, GC gc) {
+	depth = DefaultDepth(display, screen);
+	resizerBackground = XCreatePixmap(display, RootWindow(display, screen), RESIZE_CONTROL_SIZE, RESIZE_CONTROL_SIZE, depth);
+	countResource(ResourceTypePixmap, 1);
+	drawResizeButton(display, resizerBackground, gc, RECT_RESIZE_DRAW);
+	enabled = 1;
+}
+
+int frameBackgroundsEnabled(void) {
+	return enabled;
+}
+
+void releaseFrameBackgrounds(Display *display) {
+	if (resizerBackground) {
+		XFreePixmap(display, resizerBackground);
+		countResource(ResourceTypePixmap, -1);
+		resizerBackground = None;
+	}
+	enabled = 0;
+}
+
+static unsigned int withSlack(unsigned int length) {
+	return (length + FRAME_BACKGROUND_SLACK - 1) / FRAME_BACKGROUND_SLACK * FRAME_BACKGROUND_SLACK;
+}
+
+static int backgroundFits(const ManagedWindow *mw) {
+	const unsigned int width = mw->width;
+	const unsigned int height = mw->height;
+
+	return mw->background &&
+		   width <= mw->backgroundWidth && height <= mw->backgroundHeight &&
+		   width * 2 >= mw->backgroundWidth && height * 2 >= mw->backgroundHeight;
+}
+
+Pixmap frameBackgroundForPainting(Display *display, ManagedWindow *mw) {
+	if (!backgroundFits(mw)) {
+		Pixmap old = mw->background;
+
+		mw->backgroundWidth = withSlack(mw->width);
+		mw->backgroundHeight = withSlack(mw->height);
+		mw->background = XCreatePixmap(display, mw->decorationWindow, mw->backgroundWidth, mw->backgroundHeight, depth);
+		countResource(ResourceTypePixmap, 1);
+
+		if (old) {
+			/* The window keeps its own reference to the old one until the new one is installed */
+			XFreePixmap(display, old);
+			countResource(ResourceTypePixmap, -1);
+		}
+		else {
+			/* First paint, so the resizer gets its background too */
+			XSetWindowBackgroundPixmap(display, mw->resizer, resizerBackground);
+			XClearWindow(display, mw->resizer);
+		}
+	}
+
+	return mw->background;
+}
+
+void showFrameBackground(Display *display, ManagedWindow *mw) {
+	XSetWindowBackgroundPixmap(display, mw->decorationWindow, mw->background);
+	XClearWindow(display, mw->decorationWindow);
+}
+
+void releaseFrameBackground(Display *display, ManagedWindow *mw) {
+	if (mw->background) {
+		XFreePixmap(display, mw->background);
+		countResource(ResourceTypePixmap, -1);
+		mw->background = None;
+	}
+}
@@ -0,0 +1,53 @@
+/*
+ * Copyright (c) 2012 Daniel Loffgren
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef classic_wm_background_h
+#define classic_wm_background_h
+
+#include <X11/Xlib.h>
+
+#include "pool.h"
+
+/*
+ * Frame backgrounds, see -p: each frame is drawn into a pixmap that is
+ * installed as its background_pixmap, so the server repaints an exposed
+ * frame by itself and Expose never has to reach us. Only a new title, a
+ * focus change or a new size repaints the pixmap. This costs a frame sized
+ * pixmap per window on the server.
+ *
+ * Pixmaps grow in steps of FRAME_BACKGROUND_SLACK, and only shrink once a
+ * frame is under half their size, so an interactive resize doesn't create
+ * one per motion. The part outside the frame is never shown.
+ */
+#define FRAME_BACKGROUND_SLACK     (64)    /* px */
+
+void enableFrameBackgrounds(Display *display, int screen, GC gc);
+int frameBackgroundsEnabled(void);
+void releaseFrameBackgrounds(Display *display);
+
+/* Returns the pixmap to paint the whole frame into, at its current size */
+Pixmap frameBackgroundForPainting(Display *display, ManagedWindow *mw);
+/* Makes the server repaint the frame from what was painted */
+void showFrameBackground(Display *display, ManagedWindow *mw);
+void releaseFrameBackground(Display *display, ManagedWindow *mw);
+
+#endif
@@ -0,0 +1,659 @@
+/*
+ * Copyright (c) 2012 Daniel Loffgren
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/*
+ * Drives classic-wm through one benchmark scenario, with synthetic clients
+ * and XTest input, and prints the result as one line of JSON. Latency is
+ * measured from the input (or map) until the client sees the window
+ * manager's answer, such as the frame's ConfigureNotify. Requests come from
+ * the window manager's own stats, see -s.
+ */
+
+/* clock_gettime(), kill() and friends are POSIX, and hidden by -std=c89 otherwise */
+#define _POSIX_C_SOURCE 200112L
+
+#include <err.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sysexits.h>
+#include <time.h>
+#include <unistd.h>
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#include <X11/extensions/XTest.h>
+
+#define MAP_WINDOWS                (500)
+#define STACK_DEPTH                (50)
+#define DRAG_STEPS                 (200)
+#define DRAG_STEP_SIZE             (4)     /* px per motion */
+#define RESIZE_STEPS               (100)
+#define FOCUS_WINDOWS              (20)
+#define FOCUS_CLICKS               (200)
+#define CHURN_WINDOWS              (2000)
+#define OPERATION_TIMEOUT          (1.0)   /* seconds to wait for the window manager's answer */
+#define STARTUP_TIMEOUT            (10.0)  /* seconds */
+#define TITLEBAR_GRIP              (5)     /* px below the top of a frame, on its titlebar */
+#define RESIZER_GRIP               (5)     /* px in from the bottom right of a frame */
+
+typedef struct {
+	const char *name;
+	int ops;
+	int timeouts;
+	double wall;
+	double *latencies;
+	int nlatencies;
+	unsigned long requests;
+	unsigned long exposes;
+} Result;
+
+/* Running totals from the window manager's stats */
+typedef struct {
+	unsigned long requests;
+	unsigned long exposes;
+} WindowManagerCounts;
+
+static Display *display;
+static Window root;
+static const char *wmPath;
+static const char *framePolicy = "none";
+static char statsPath[64];
+static pid_t wm = -1;
+
+static double currentTime(void) {
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (double)now.tv_sec + (double)now.tv_nsec / 1e9;
+}
+
+static void sleepFor(double seconds) {
+	poll(NULL, 0, (int)(seconds * 1000.0));
+}
+
+/* Waits until deadline for the next event */
+static int nextEvent(XEvent *ev, double deadline) {
+	struct pollfd fd;
+
+	for (;;) {
+		if (XPending(display)) {
+			XNextEvent(display, ev);
+			return 1;
+		}
+
+		const double left = deadline - currentTime();
+		if (left <= 0) {
+			return 0;
+		}
+
+		fd.fd = ConnectionNumber(display);
+		fd.events = POLLIN;
+		poll(&fd, 1, (int)(left * 1000.0) + 1);
+	}
+}
+
+static int waitForConfigure(Window window, int (*done)(const XConfigureEvent *event, const void *context), const void *context) {
+	const double deadline = currentTime() + OPERATION_TIMEOUT;
+	XEvent ev;
+
+	while (nextEvent(&ev, deadline)) {
+		if (ev.type == ConfigureNotify && ev.xconfigure.window == window && done(&ev.xconfigure, context)) {
+			return 1;
+		}
+	}
+	return 0;
+}
+
+static void recordLatency(Result *result, double latency) {
+	result->latencies[result->nlatencies++] = latency;
+}
+
+static int compareLatencies(const void *a, const void *b) {
+	const double x = *(const double *)a;
+	const double y = *(const double *)b;
+	return (x > y) - (x < y);
+}
+
+static double percentile(const Result *result, int p) {
+	if (!result->nlatencies) {
+		return 0;
+	}
+	return result->latencies[(result->nlatencies - 1) * p / 100];
+}
+
+static void printResult(Result *result) {
+	qsort(result->latencies, result->nlatencies, sizeof(double), compareLatencies);
+	printf("{\"scenario\": \"%s\", \"policy\": \"%s\", \"ops\": %d, \"timeouts\": %d, \"wall_s\": %.4f, "
+		   "\"p50_ms\": %.3f, \"p99_ms\": %.3f, \"requests\": %lu, \"requests_per_op\": %.2f, \"exposes\": %lu}\n",
+		   result->name, framePolicy, result->ops, result->timeouts, result->wall,
+		   percentile(result, 50) * 1000.0, percentile(result, 99) * 1000.0,
+		   result->requests, result->ops ? (double)result->requests / result->ops : 0, result->exposes);
+	fflush(stdout);
+}
+
+/* The window manager has started once something selects SubstructureRedirect or Notify on the root */
+static void waitForWindowManager(void) {
+	const double deadline = currentTime() + STARTUP_TIMEOUT;
+	XWindowAttributes attr;
+
+	do {
+		XGetWindowAttributes(display, root, &attr);
+		if (attr.all_event_masks & (SubstructureNotifyMask | SubstructureRedirectMask)) {
+			return;
+		}
+		sleepFor(0.01);
+	} while (currentTime() < deadline);
+
+	errx(EX_SOFTWARE, "%s never started", wmPath);
+}
+
+static void startWindowManager(void) {
+	snprintf(statsPath, sizeof(statsPath), "/tmp/classic-wm-bench.%ld.stats", (long)getpid());
+	unlink(statsPath);
+
+	wm = fork();
+	if (wm < 0) {
+		err(EX_OSERR, "fork");
+	}
+	if (wm == 0) {
+		execl(wmPath, wmPath, "-s", statsPath, "-b", framePolicy, (char *)NULL);
+		_exit(EX_UNAVAILABLE);
+	}
+}
+
+static void stopWindowManager(void) {
+	if (wm > 0) {
+		kill(wm, SIGTERM);
+		waitpid(wm, NULL, 0);
+		wm = -1;
+	}
+	unlink(statsPath);
+}
+
+/* Asks the window manager for a stats dump, with every request it has sent and Expose it has had so far */
+static void windowManagerCounts(WindowManagerCounts *counts) {
+	const double deadline = currentTime() + STARTUP_TIMEOUT;
+	int requestsFound = 0;
+	long offset = 0;
+	char line[256];
+	FILE *stats;
+
+	stats = fopen(statsPath, "r");
+	if (stats) {
+		fseek(stats, 0, SEEK_END);
+		offset = ftell(stats);
+		fclose(stats);
+	}
+
+	kill(wm, SIGUSR1);
+	do {
+		sleepFor(0.01);
+		stats = fopen(statsPath, "r");
+		if (!stats) {
+			continue;
+		}
+
+		/* The counters follow the totals, so a dump still being written is read again */
+		fseek(stats, offset, SEEK_SET);
+		requestsFound = 0;
+		while (fgets(line, sizeof(line), stats)) {
+			if (sscanf(line, "total: events %*u requests %lu", &counts->requests) == 1) {
+				requestsFound = 1;
+			}
+			else if (requestsFound && sscanf(line, "expose received: %lu", &counts->exposes) == 1) {
+				fclose(stats);
+				return;
+			}
+		}
+		fclose(stats);
+	} while (currentTime() < deadline);
+
+	warnx("no stats from %s", wmPath);
+	counts->requests = 0;
+	counts->exposes = 0;
+}
+
+/* Charges the result with everything the window manager did since before */
+static void countSince(Result *result, const WindowManagerCounts *before) {
+	WindowManagerCounts now;
+
+	windowManagerCounts(&now);
+	result->requests = now.requests - before->requests;
+	result->exposes = now.exposes - before->exposes;
+}
+
+static Window createClient(int x, int y, int width, int height) {
+	Window window = XCreateSimpleWindow(display, root, x, y, width, height, 1,
+										BlackPixel(display, DefaultScreen(display)),
+										WhitePixel(display, DefaultScreen(display)));
+	XSelectInput(display, window, StructureNotifyMask);
+	return window;
+}
+
+/* Waits for the window manager to reparent each of windows, filling in their frames */
+static int waitForFrames(const Window *windows, Window *frames, const double *since, int count, Result *result) {
+	const double deadline = currentTime() + STARTUP_TIMEOUT + count * OPERATION_TIMEOUT / 100;
+	int framed = 0;
+	int i;
+	XEvent ev;
+
+	while (framed < count && nextEvent(&ev, deadline)) {
+		if (ev.type != ReparentNotify || ev.xreparent.parent == root) {
+			continue;
+		}
+
+		for (i = 0; i < count; i++) {
+			if (windows[i] == ev.xreparent.window && !frames[i]) {
+				frames[i] = ev.xreparent.parent;
+				XSelectInput(display, frames[i], StructureNotifyMask);
+				if (result) {
+					recordLatency(result, currentTime() - since[i]);
+				}
+				framed++;
+				break;
+			}
+		}
+	}
+
+	if (result) {
+		result->timeouts += count - framed;
+	}
+	return framed == count;
+}
+
+static void frameGeometry(Window frame, int *x, int *y, unsigned int *width, unsigned int *height) {
+	Window ignored;
+	unsigned int border;
+	unsigned int depth;
+
+	XGetGeometry(display, frame, &ignored, x, y, width, height, &border, &depth);
+}
+
+static void pointerTo(int x, int y) {
+	XTestFakeMotionEvent(display, -1, x, y, CurrentTime);
+}
+
+static void button(Bool down) {
+	XTestFakeButtonEvent(display, 1, down, CurrentTime);
+}
+
+static int framedAt(const XConfigureEvent *event, const void *context) {
+	return event->x == *(const int *)context;
+}
+
+static int clientAtLeast(const XConfigureEvent *event, const void *context) {
+	return event->width >= *(const int *)context;
+}
+
+static int anyConfigure(const XConfigureEvent *event, const void *context) {
+	(void)event;
+	(void)context;
+	return 1;
+}
+
+static void mapScenario(Result *result) {
+	Window windows[MAP_WINDOWS];
+	Window frames[MAP_WINDOWS];
+	double mapped[MAP_WINDOWS];
+	WindowManagerCounts before;
+	double start;
+	int i;
+
+	startWindowManager();
+	waitForWindowManager();
+	windowManagerCounts(&before);
+
+	start = currentTime();
+	for (i = 0; i < MAP_WINDOWS; i++) {
+		windows[i] = createClient(rand() % 800, rand() % 600, 100 + rand() % 200, 100 + rand() % 200);
+		frames[i] = None;
+		mapped[i] = currentTime();
+		XMapWindow(display, windows[i]);
+	}
+	XFlush(display);
+	waitForFrames(windows, frames, mapped, MAP_WINDOWS, result);
+	result->wall = currentTime() - start;
+
+	result->ops = MAP_WINDOWS;
+	countSince(result, &before);
+}
+
+static void adoptScenario(Result *result) {
+	const WindowManagerCounts nothing = {0, 0};
+	Window windows[MAP_WINDOWS];
+	Window frames[MAP_WINDOWS];
+	double started[MAP_WINDOWS];
+	double start;
+	int i;
+
+	/* Everything is mapped and settled before the window manager exists */
+	for (i = 0; i < MAP_WINDOWS; i++) {
+		windows[i] = createClient(rand() % 800, rand() % 600, 100 + rand() % 200, 100 + rand() % 200);
+		frames[i] = None;
+		XMapWindow(display, windows[i]);
+	}
+	XSync(display, False);
+
+	start = currentTime();
+	for (i = 0; i < MAP_WINDOWS; i++) {
+		started[i] = start;
+	}
+	startWindowManager();
+	waitForFrames(windows, frames, started, MAP_WINDOWS, result);
+	result->wall = currentTime() - start;
+
+	result->ops = MAP_WINDOWS;
+	countSince(result, &nothing);
+}
+
+static void dragScenario(Result *result) {
+	Window stack[STACK_DEPTH];
+	Window stackFrames[STACK_DEPTH];
+	Window window;
+	Window frame = None;
+	WindowManagerCounts before;
+	unsigned int width;
+	unsigned int height;
+	double start;
+	int x;
+	int y;
+	int i;
+
+	startWindowManager();
+	waitForWindowManager();
+
+	/* A deep pile of windows for the dragged one to cross */
+	for (i = 0; i < STACK_DEPTH; i++) {
+		stack[i] = createClient(300 + i * 2, 100 + i * 2, 400, 300);
+		stackFrames[i] = None;
+		XMapWindow(display, stack[i]);
+	}
+	window = createClient(20, 100, 200, 150);
+	XMapWindow(display, window);
+	XFlush(display);
+	waitForFrames(stack, stackFrames, NULL, STACK_DEPTH, NULL);
+	waitForFrames(&window, &frame, NULL, 1, NULL);
+	frameGeometry(frame, &x, &y, &width, &height);
+
+	windowManagerCounts(&before);
+	start = currentTime();
+
+	pointerTo(x + 40, y + TITLEBAR_GRIP);
+	button(True);
+	for (i = 1; i <= DRAG_STEPS; i++) {
+		int expected = x + i * DRAG_STEP_SIZE;
+		const double moved = currentTime();
+
+		pointerTo(x + 40 + i * DRAG_STEP_SIZE, y + TITLEBAR_GRIP);
+		XFlush(display);
+		if (waitForConfigure(frame, framedAt, &expected)) {
+			recordLatency(result, currentTime() - moved);
+		}
+		else {
+			result->timeouts++;
+		}
+	}
+	button(False);
+	XSync(display, False);
+
+	result->wall = currentTime() - start;
+	result->ops = DRAG_STEPS;
+	countSince(result, &before);
+}
+
+static void resizeScenario(Result *result) {
+	Window window;
+	Window frame = None;
+	WindowManagerCounts before;
+	unsigned int width;
+	unsigned int height;
+	double start;
+	int clientWidth;
+	int x;
+	int y;
+	int i;
+
+	startWindowManager();
+	waitForWindowManager();
+
+	clientWidth = 300;
+	window = createClient(100, 100, clientWidth, 200);
+	XMapWindow(display, window);
+	XFlush(display);
+	waitForFrames(&window, &frame, NULL, 1, NULL);
+	frameGeometry(frame, &x, &y, &width, &height);
+
+	windowManagerCounts(&before);
+	start = currentTime();
+
+	pointerTo(x + width - RESIZER_GRIP, y + height - RESIZER_GRIP);
+	button(True);
+	for (i = 1; i <= RESIZE_STEPS; i++) {
+		int expected = clientWidth + i * 3;
+		const double moved = currentTime();
+
+		pointerTo(x + width - RESIZER_GRIP + i * 3, y + height - RESIZER_GRIP + i * 2);
+		XFlush(display);
+		if (waitForConfigure(window, clientAtLeast, &expected)) {
+			recordLatency(result, currentTime() - moved);
+		}
+		else {
+			result->timeouts++;
+		}
+	}
+	button(False);
+	XSync(display, False);
+
+	result->wall = currentTime() - start;
+	result->ops = RESIZE_STEPS;
+	countSince(result, &before);
+}
+
+static void focusScenario(Result *result) {
+	Window windows[FOCUS_WINDOWS];
+	Window frames[FOCUS_WINDOWS];
+	WindowManagerCounts before;
+	unsigned int width;
+	unsigned int height;
+	double start;
+	int x;
+	int y;
+	int i;
+
+	startWindowManager();
+	waitForWindowManager();
+
+	for (i = 0; i < FOCUS_WINDOWS; i++) {
+		windows[i] = createClient(20 + (i % 5) * 180, 40 + (i / 5) * 160, 150, 100);
+		frames[i] = None;
+		XMapWindow(display, windows[i]);
+	}
+	XFlush(display);
+	waitForFrames(windows, frames, NULL, FOCUS_WINDOWS, NULL);
+
+	windowManagerCounts(&before);
+	start = currentTime();
+
+	/* 7 is coprime with the window count, so no window is clicked twice in a row */
+	for (i = 0; i < FOCUS_CLICKS; i++) {
+		const Window frame = frames[(i * 7) % FOCUS_WINDOWS];
+		double clicked;
+
+		frameGeometry(frame, &x, &y, &width, &height);
+		clicked = currentTime();
+		pointerTo(x + 40, y + TITLEBAR_GRIP);
+		button(True);
+		button(False);
+		XFlush(display);
+
+		/* Raising the frame restacks it, which it reports with a ConfigureNotify */
+		if (waitForConfigure(frame, anyConfigure, NULL)) {
+			recordLatency(result, currentTime() - clicked);
+		}
+		else {
+			result->timeouts++;
+		}
+	}
+
+	result->wall = currentTime() - start;
+	result->ops = FOCUS_CLICKS;
+	countSince(result, &before);
+}
+
+static void churnScenario(Result *result) {
+	WindowManagerCounts before;
+	Window window;
+	Window frame;
+	double start;
+	double mapped;
+	int status;
+	int i;
+
+	startWindowManager();
+	waitForWindowManager();
+
+	windowManagerCounts(&before);
+	start = currentTime();
+
+	/*
+	 * Short lived windows, every other one destroyed before the window
+	 * manager can have framed it, so its requests on them start failing
+	 * halfway through.
+	 */
+	for (i = 0; i < CHURN_WINDOWS; i++) {
+		window = createClient(rand() % 800, rand() % 600, 50 + rand() % 200, 50 + rand() % 200);
+		frame = None;
+		mapped = currentTime();
+		XMapWindow(display, window);
+
+		if (i % 2 == 0) {
+			waitForFrames(&window, &frame, &mapped, 1, result);
+		}
+		XDestroyWindow(display, window);
+		XFlush(display);
+	}
+
+	/* The window manager is still there, and still framing windows */
+	window = createClient(20, 100, 200, 150);
+	frame = None;
+	XMapWindow(display, window);
+	XFlush(display);
+	if (!waitForFrames(&window, &frame, NULL, 1, NULL)) {
+		if (waitpid(wm, &status, WNOHANG) == wm) {
+			wm = -1;
+			errx(EX_SOFTWARE, "%s did not survive the churn", wmPath);
+		}
+		stopWindowManager();
+		errx(EX_SOFTWARE, "%s stopped framing windows after the churn", wmPath);
+	}
+
+	result->wall = currentTime() - start;
+	result->ops = CHURN_WINDOWS;
+	countSince(result, &before);
+}
+
+static const struct {
+	const char *name;
+	void (*run)(Result *result);
+	int maxLatencies;
+} scenarios[] = {
+	{ "map", mapScenario, MAP_WINDOWS },
+	{ "adopt", adoptScenario, MAP_WINDOWS },
+	{ "drag", dragScenario, DRAG_STEPS },
+	{ "resize", resizeScenario, RESIZE_STEPS },
+	{ "focus", focusScenario, FOCUS_CLICKS },
+	{ "churn", churnScenario, CHURN_WINDOWS },
+};
+
+static void usage(void) {
+	fprintf(stderr, "usage: benchclient -w classic-wm [-b policy] scenario\n");
+	fprintf(stderr, "scenarios: map adopt drag resize focus churn\n");
+	exit(EX_USAGE);
+}
+
+int main(int argc, char * const argv[]) {
+	const int count = sizeof(scenarios) / sizeof(scenarios[0]);
+	Result result;
+	int event;
+	int error;
+	int major;
+	int minor;
+	int ch;
+	int i;
+
+	while ((ch = getopt(argc, argv, "b:w:")) != -1) {
+		switch (ch) {
+			case 'b': {
+				framePolicy = optarg;
+			} break;
+			case 'w': {
+				wmPath = optarg;
+			} break;
+			default:
+				usage();
+		}
+	}
+	if (!wmPath || optind != argc - 1) {
+		usage();
+	}
+
+	display = XOpenDisplay(NULL);
+	if (!display) {
+		errx(EX_UNAVAILABLE, "Failed to open display, is Xvfb running?");
+	}
+	if (!XTestQueryExtension(display, &event, &error, &major, &minor)) {
+		errx(EX_UNAVAILABLE, "The XTEST extension is missing");
+	}
+	/* Nothing may be selected on the root here, see waitForWindowManager() */
+	root = DefaultRootWindow(display);
+
+	/* The same windows every run, so runs can be compared */
+	srand(1);
+
+	for (i = 0; i < count; i++) {
+		if (strcmp(scenarios[i].name, argv[optind])) {
+			continue;
+		}
+
+		memset(&result, 0, sizeof(result));
+		result.name = scenarios[i].name;
+		result.latencies = calloc(scenarios[i].maxLatencies, sizeof(double));
+		if (!result.latencies) {
+			err(EX_OSERR, "calloc");
+		}
+
+		scenarios[i].run(&result);
+		stopWindowManager();
+		printResult(&result);
+
+		free(result.latencies);
+		XCloseDisplay(display);
+		return 0;
+	}
+
+	usage();
+	return EX_USAGE;
+}
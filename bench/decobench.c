@@ -0,0 +1,199 @@
+/*
+ * Copyright (c) 2012 Daniel Loffgren
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/*
+ * Renders decorations on the raster canvas, with no server at all, and
+ * prints frames per second for each case as one line of JSON. A damaged
+ * redraw is also compared pixel for pixel with a full one, so redraw
+ * optimizations can be checked as well as timed.
+ */
+
+/* getopt() is POSIX, and hidden by -std=c89 otherwise */
+#define _POSIX_C_SOURCE 200112L
+
+#include <err.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sysexits.h>
+#include <unistd.h>
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+
+#include "../decorations.h"
+#include "../raster.h"
+#include "../timing.h"
+
+#define DEFAULT_FRAMES             (10000)
+#define FRAME_WIDTH                (640)
+#define FRAME_HEIGHT               (480)
+#define TITLE                      "classic-wm decoration benchmark - a title long enough to be ellipsized when narrow"
+
+typedef struct {
+	Canvas *canvas;
+	TitleLayout *title;
+	XWindowAttributes attr;
+	Region damage;
+	int frame;
+} Context;
+
+static void drawFull(Context *context) {
+	drawDecorationsOnCanvas(context->canvas, context->title, context->attr, 1, NULL);
+}
+
+static void drawUnfocused(Context *context) {
+	drawDecorationsOnCanvas(context->canvas, context->title, context->attr, 0, NULL);
+}
+
+static void drawDamaged(Context *context) {
+	drawDecorationsOnCanvas(context->canvas, context->title, context->attr, 1, context->damage);
+}
+
+static void drawButtons(Context *context) {
+	const XWindowAttributes attr = context->attr;
+
+	drawCloseButtonOnCanvas(context->canvas, RECT_CLOSE_BTN);
+	drawCloseButtonDownOnCanvas(context->canvas, RECT_CLOSE_BTN);
+	drawMaximizeButtonOnCanvas(context->canvas, RECT_MAX_BTN);
+	drawCollapseButtonOnCanvas(context->canvas, FIRST_RIGHTMOST_BTN);
+	drawResizeButtonOnCanvas(context->canvas, RECT_RESIZE_BTN);
+}
+
+/* A live resize, where every frame is a new width, and the title is laid out again */
+static void drawResizing(Context *context) {
+	XWindowAttributes attr = context->attr;
+	attr.width = FRAME_WIDTH / 4 + (context->frame * 7) % (FRAME_WIDTH * 3 / 4);
+	drawDecorationsOnCanvas(context->canvas, context->title, attr, 1, NULL);
+}
+
+static const struct {
+	const char *name;
+	void (*draw)(Context *context);
+	int damaged;               /* clipped to the title */
+} cases[] = {
+	{ "full", drawFull, 0 },
+	{ "unfocused", drawUnfocused, 0 },
+	{ "title-damage", drawDamaged, 1 },
+	{ "buttons", drawButtons, 0 },
+	{ "resizing", drawResizing, 0 },
+};
+
+static void usage(void) {
+	fprintf(stderr, "usage: decobench [-n frames] [-p file.pbm]\n");
+	exit(EX_USAGE);
+}
+
+int main(int argc, char * const argv[]) {
+	const int count = sizeof(cases) / sizeof(cases[0]);
+	const char *pbmPath = NULL;
+	int frames = DEFAULT_FRAMES;
+	Canvas canvas;
+	Canvas reference;
+	TitleLayout title;
+	XRectangle bounds;
+	Context context;
+	int ch;
+	int i;
+
+	while ((ch = getopt(argc, argv, "n:p:")) != -1) {
+		switch (ch) {
+			case 'n': {
+				frames = atoi(optarg);
+				if (frames <= 0) {
+					usage();
+				}
+			} break;
+			case 'p': {
+				pbmPath = optarg;
+			} break;
+			default:
+				usage();
+		}
+	}
+
+	if (!createRasterCanvas(&canvas, FRAME_WIDTH, FRAME_HEIGHT, NULL) ||
+		!createRasterCanvas(&reference, FRAME_WIDTH, FRAME_HEIGHT, NULL)) {
+		errx(EX_OSERR, "unable to allocate canvases");
+	}
+
+	memset(&title, 0, sizeof(title));
+	setTitleLayoutTitle(&title, TITLE);
+	memset(&context, 0, sizeof(context));
+	context.canvas = &canvas;
+	context.title = &title;
+	context.attr.width = FRAME_WIDTH;
+	context.attr.height = FRAME_HEIGHT;
+
+	/* The damage is the title, which is what a title change repaints */
+	context.damage = XCreateRegion();
+	drawFull(&context);
+	titleBoundsOnCanvas(&canvas, &title, context.attr, &bounds);
+	XUnionRectWithRegion(&bounds, context.damage, context.damage);
+
+	for (i = 0; i < count; i++) {
+		double start;
+		double elapsed;
+		int differences = 0;
+
+		clearRasterCanvas(&canvas);
+		setRasterClip(&canvas, cases[i].damaged ? context.damage : NULL);
+		start = currentTime();
+		for (context.frame = 0; context.frame < frames; context.frame++) {
+			cases[i].draw(&context);
+		}
+		elapsed = currentTime() - start;
+		setRasterClip(&canvas, NULL);
+
+		/* A damaged redraw on top of a full one must leave it exactly as it was */
+		if (cases[i].damaged) {
+			context.canvas = &reference;
+			drawFull(&context);
+			context.canvas = &canvas;
+			drawFull(&context);
+			setRasterClip(&canvas, context.damage);
+			drawDamaged(&context);
+			setRasterClip(&canvas, NULL);
+			differences = compareRasterCanvases(&canvas, &reference);
+		}
+
+		printf("{\"case\": \"%s\", \"frames\": %d, \"wall_s\": %.4f, \"fps\": %.0f, \"us_per_frame\": %.2f, \"pixels_differing\": %d}\n",
+			   cases[i].name, frames, elapsed, frames / elapsed, elapsed * 1e6 / frames, differences);
+	}
+
+	if (pbmPath) {
+		FILE *out = fopen(pbmPath, "wb");
+		if (!out) {
+			err(EX_CANTCREAT, "%s", pbmPath);
+		}
+		clearRasterCanvas(&canvas);
+		drawFull(&context);
+		writeRasterPBM(&canvas, out);
+		fclose(out);
+	}
+
+	XDestroyRegion(context.damage);
+	releaseTitleLayout(&title);
+	releaseRasterCanvas(&canvas);
+	releaseRasterCanvas(&reference);
+
+	return 0;
+}
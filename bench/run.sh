@@ -0,0 +1,37 @@
+#!/bin/sh
+#
+# Runs each benchmark scenario against classic-wm on a private Xvfb, and
+# prints one JSON object per scenario, so that runs can be diffed or fed
+# to other tools. Set SCENARIOS to run only some, POLICIES to repeat them
+# under other -b frame store policies, and BENCH_DISPLAY if :99 is taken.
+#
+
+cd "$(dirname "$0")/.." || exit 1
+
+BENCH_DISPLAY=${BENCH_DISPLAY:-:99}
+SCENARIOS=${SCENARIOS:-"map adopt drag resize focus churn"}
+POLICIES=${POLICIES:-"none"}
+
+# With +bs, -b backing has something to measure
+Xvfb "$BENCH_DISPLAY" -screen 0 1280x1024x24 +bs -nolisten tcp >/dev/null 2>&1 &
+XVFB=$!
+trap 'kill $XVFB 2>/dev/null' EXIT INT TERM
+
+# Wait for the server to start listening
+tries=0
+while [ ! -S "/tmp/.X11-unix/X${BENCH_DISPLAY#:}" ]; do
+	tries=$((tries + 1))
+	if [ $tries -gt 100 ] || ! kill -0 $XVFB 2>/dev/null; then
+		echo "Xvfb did not start on $BENCH_DISPLAY" >&2
+		exit 1
+	fi
+	sleep 0.1
+done
+
+status=0
+for policy in $POLICIES; do
+	for scenario in $SCENARIOS; do
+		DISPLAY=$BENCH_DISPLAY ./bench/benchclient -w ./classic-wm -b "$policy" "$scenario" || status=1
+	done
+done
+exit $status
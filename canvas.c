@@ -0,0 +1,88 @@
+/*
+ * Copyright (c) 2012 Daniel Loffgren
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "canvas.h"
+#include "resources.h"
+
+static void xlibFillRectangles(Canvas *canvas, CanvasColor color, const XRectangle *rects, int count) {
+	XSetForeground(canvas->display, canvas->gc, canvas->pixels[color]);
+	XFillRectangles(canvas->display, canvas->drawable, canvas->gc, (XRectangle *)rects, count);
+}
+
+static void xlibDrawRectangles(Canvas *canvas, CanvasColor color, const XRectangle *rects, int count) {
+	XSetForeground(canvas->display, canvas->gc, canvas->pixels[color]);
+	XDrawRectangles(canvas->display, canvas->drawable, canvas->gc, (XRectangle *)rects, count);
+}
+
+static void xlibDrawSegments(Canvas *canvas, CanvasColor color, const XSegment *segments, int count) {
+	XSetForeground(canvas->display, canvas->gc, canvas->pixels[color]);
+	XDrawSegments(canvas->display, canvas->drawable, canvas->gc, (XSegment *)segments, count);
+}
+
+static void xlibDrawPoints(Canvas *canvas, CanvasColor color, const XPoint *points, int count) {
+	XSetForeground(canvas->display, canvas->gc, canvas->pixels[color]);
+	XDrawPoints(canvas->display, canvas->drawable, canvas->gc, (XPoint *)points, count, CoordModeOrigin);
+}
+
+static void xlibDrawText(Canvas *canvas, int x, int y, const XTextItem *items, int count) {
+	/* The shared GC already has the font */
+	XSetForeground(canvas->display, canvas->gc, canvas->pixels[CanvasBlack]);
+	XDrawText(canvas->display, canvas->drawable, canvas->gc, x, y, (XTextItem *)items, count);
+}
+
+static void xlibCopyPixmap(Canvas *canvas, Pixmap source, int width, int height, int x, int y) {
+	XCopyArea(canvas->display, source, canvas->drawable, canvas->gc, 0, 0, width, height, x, y);
+}
+
+static void xlibFillTiled(Canvas *canvas, int x, int y, int width, int height) {
+	/* The tile is set once, by loadDecorationAtlas() */
+	XSetFillStyle(canvas->display, canvas->gc, FillTiled);
+	XFillRectangle(canvas->display, canvas->drawable, canvas->gc, x, y, width, height);
+	XSetFillStyle(canvas->display, canvas->gc, FillSolid);
+}
+
+static const CanvasOps xlibOps = {
+	xlibFillRectangles,
+	xlibDrawRectangles,
+	xlibDrawSegments,
+	xlibDrawPoints,
+	xlibDrawText,
+	xlibCopyPixmap,
+	xlibFillTiled,
+};
+
+void initXlibCanvas(Canvas *canvas, Display *display, Drawable drawable, GC gc) {
+	const ScreenResources *res = resourcesForScreen(display, DefaultScreen(display));
+
+	canvas->ops = &xlibOps;
+	canvas->advances = res->advances;
+	canvas->display = display;
+	canvas->drawable = drawable;
+	canvas->gc = gc;
+	canvas->pixels[CanvasWhite] = res->white;
+	canvas->pixels[CanvasBlack] = res->black;
+	canvas->bits = NULL;
+	canvas->width = 0;
+	canvas->height = 0;
+	canvas->stride = 0;
+	canvas->clip = NULL;
+}
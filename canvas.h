@@ -0,0 +1,81 @@
+/*
+ * Copyright (c) 2012 Daniel Loffgren
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef classic_wm_canvas_h
+#define classic_wm_canvas_h
+
+#include <X11/Xlib.h>
+#include <X11/Xutil.h> /* Region */
+
+/*
+ * What decorations.c draws on. The Xlib backend draws on a window or pixmap
+ * through a GC. The raster backend (see raster.h) draws into a 1-bit image
+ * in memory, so decorations can be rendered, benchmarked and compared
+ * without a server. Colors are passed with each call, instead of living in
+ * GC state, so neither backend depends on what was drawn before.
+ */
+typedef enum {
+	CanvasWhite = 0,
+	CanvasBlack,
+	CanvasColorCount
+} CanvasColor;
+
+typedef struct Canvas_t Canvas;
+
+typedef struct {
+	/* The same geometry as their Xlib counterparts */
+	void (*fillRectangles)(Canvas *canvas, CanvasColor color, const XRectangle *rects, int count);
+	void (*drawRectangles)(Canvas *canvas, CanvasColor color, const XRectangle *rects, int count);
+	void (*drawSegments)(Canvas *canvas, CanvasColor color, const XSegment *segments, int count);
+	void (*drawPoints)(Canvas *canvas, CanvasColor color, const XPoint *points, int count);
+
+	/* In black, in the title font, with x and y at the start of the baseline */
+	void (*drawText)(Canvas *canvas, int x, int y, const XTextItem *items, int count);
+
+	/* Only the Xlib backend can use the decoration atlas, these are NULL elsewhere */
+	void (*copyPixmap)(Canvas *canvas, Pixmap source, int width, int height, int x, int y);
+	void (*fillTiled)(Canvas *canvas, int x, int y, int width, int height);
+} CanvasOps;
+
+struct Canvas_t {
+	const CanvasOps *ops;
+	const int *advances;       /* px of each Latin-1 character in the title font */
+
+	/* Xlib */
+	Display *display;
+	Drawable drawable;
+	GC gc;
+	unsigned long pixels[CanvasColorCount];
+
+	/* Raster, one bit per pixel, set for black */
+	unsigned char *bits;
+	int width;
+	int height;
+	int stride;                /* bytes per row */
+	Region clip;               /* NULL for none */
+	const struct RasterFont_t *font;    /* NULL to greek text */
+};
+
+/* Cheap enough to set up on the stack for every draw */
+void initXlibCanvas(Canvas *canvas, Display *display, Drawable drawable, GC gc);
+
+#endif
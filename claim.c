@@ -0,0 +1,316 @@
+/*
+ * Copyright (c) 2012 Daniel Loffgren
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if XCB_ADOPTION_ENABLED
+#include <X11/Xlib-xcb.h>
+#include <xcb/xcb.h>
+#include <xcb/xproto.h>
+#endif
+
+#include "atoms.h"
+#include "claim.h"
+#include "properties.h"
+
+/* Windows that shouldn't be decorated (yet), unviewable ones get claimed when they map */
+static int isClaimable(int mapState, int class, int overrideRedirect) {
+	return mapState == IsViewable && class == InputOutput && !overrideRedirect;
+}
+
+#if XCB_ADOPTION_ENABLED
+/* WM_NORMAL_HINTS is 18 CARD32s, or 15 from pre-ICCCM clients */
+#define SIZE_HINTS_ELEMENTS        (18)
+#define OLD_SIZE_HINTS_ELEMENTS    (15)
+#define MAX_PROTOCOLS              (32)
+
+static void parseSizeHints(const xcb_get_property_reply_t *reply, ClaimInfo *info) {
+	const int elements = xcb_get_property_value_length((xcb_get_property_reply_t *)reply) / 4;
+	const unsigned int *data = xcb_get_property_value((xcb_get_property_reply_t *)reply);
+
+	if (reply->format != 32 || elements < OLD_SIZE_HINTS_ELEMENTS) {
+		return;
+	}
+
+	info->hints.flags = data[0];
+	info->hints.x = (int)data[1];
+	info->hints.y = (int)data[2];
+	info->hints.width = (int)data[3];
+	info->hints.height = (int)data[4];
+	info->hints.min_width = (int)data[5];
+	info->hints.min_height = (int)data[6];
+	info->hints.max_width = (int)data[7];
+	info->hints.max_height = (int)data[8];
+	info->hints.width_inc = (int)data[9];
+	info->hints.height_inc = (int)data[10];
+	info->hints.min_aspect.x = (int)data[11];
+	info->hints.min_aspect.y = (int)data[12];
+	info->hints.max_aspect.x = (int)data[13];
+	info->hints.max_aspect.y = (int)data[14];
+
+	/* Mirror what XGetWMNormalHints reports as supplied */
+	info->supplied_hints = USPosition | USSize | PAllHints;
+	if (elements >= SIZE_HINTS_ELEMENTS) {
+		info->hints.base_width = (int)data[15];
+		info->hints.base_height = (int)data[16];
+		info->hints.win_gravity = (int)data[17];
+		info->supplied_hints |= PBaseSize | PWinGravity;
+	}
+	info->hints.flags &= info->supplied_hints;
+}
+
+/* xcb_window_t is always 32 bits, but Window is a long */
+static Window *copyXCBChildren(const xcb_window_t *children, unsigned int nchildren) {
+	Window *copy;
+	unsigned int i;
+
+	if (!nchildren) {
+		return NULL;
+	}
+
+	copy = malloc(nchildren * sizeof(Window));
+	assert(copy);
+	for (i = 0; i < nchildren; i++) {
+		copy[i] = children[i];
+	}
+	return copy;
+}
+
+static char *copyTitle(const char *title, int length) {
+	char *copy = malloc(length + 1);
+	assert(copy);
+	memcpy(copy, title, length);
+	copy[length] = '\0';
+	return copy;
+}
+
+static int parseProtocols(const xcb_get_property_reply_t *reply) {
+	const int elements = xcb_get_property_value_length((xcb_get_property_reply_t *)reply) / 4;
+	const uint32_t *data = xcb_get_property_value((xcb_get_property_reply_t *)reply);
+	int protocols = 0;
+	int i;
+
+	if (reply->format != 32) {
+		return 0;
+	}
+
+	for (i = 0; i < elements; i++) {
+		protocols |= protocolForAtom(data[i]);
+	}
+	return protocols;
+}
+
+/* Windows asking to be mapped aren't viewable yet, so only adoption requires it */
+static unsigned int fetchPipelinedClaimInfo(Display *display, const Window *windows, unsigned int count, ClaimInfo *infos, int viewableOnly) {
+	xcb_connection_t *connection = XGetXCBConnection(display);
+	unsigned int claimable = 0;
+	unsigned int i;
+
+	xcb_get_window_attributes_cookie_t *attributeCookies = malloc(count * sizeof(xcb_get_window_attributes_cookie_t));
+	xcb_get_geometry_cookie_t *geometryCookies = malloc(count * sizeof(xcb_get_geometry_cookie_t));
+	xcb_get_property_cookie_t *hintsCookies = malloc(count * sizeof(xcb_get_property_cookie_t));
+	xcb_get_property_cookie_t *nameCookies = malloc(count * sizeof(xcb_get_property_cookie_t));
+	xcb_get_property_cookie_t *netNameCookies = malloc(count * sizeof(xcb_get_property_cookie_t));
+	xcb_query_tree_cookie_t *treeCookies = malloc(count * sizeof(xcb_query_tree_cookie_t));
+	xcb_get_property_cookie_t *protocolsCookies = malloc(count * sizeof(xcb_get_property_cookie_t));
+	xcb_get_property_cookie_t *counterCookies = malloc(count * sizeof(xcb_get_property_cookie_t));
+	assert(attributeCookies && geometryCookies && hintsCookies && nameCookies && netNameCookies && treeCookies && protocolsCookies && counterCookies);
+
+	/* Issue every query up front, so this costs one round trip instead of one per window */
+	for (i = 0; i < count; i++) {
+		attributeCookies[i] = xcb_get_window_attributes(connection, windows[i]);
+		geometryCookies[i] = xcb_get_geometry(connection, windows[i]);
+		hintsCookies[i] = xcb_get_property(connection, 0, windows[i], XCB_ATOM_WM_NORMAL_HINTS, XCB_ATOM_WM_SIZE_HINTS, 0, SIZE_HINTS_ELEMENTS);
+		nameCookies[i] = xcb_get_property(connection, 0, windows[i], XCB_ATOM_WM_NAME, XCB_ATOM_STRING, 0, 256);
+		netNameCookies[i] = xcb_get_property(connection, 0, windows[i], atomNamed(AtomNetWMName), atomNamed(AtomUTF8String), 0, 256);
+		treeCookies[i] = xcb_query_tree(connection, windows[i]);
+		protocolsCookies[i] = xcb_get_property(connection, 0, windows[i], atomNamed(AtomWMProtocols), XCB_ATOM_ATOM, 0, MAX_PROTOCOLS);
+		counterCookies[i] = xcb_get_property(connection, 0, windows[i], atomNamed(AtomNetWMSyncRequestCounter), XCB_ATOM_CARDINAL, 0, 1);
+	}
+
+	/* Every reply has to be collected, even for windows that get skipped */
+	for (i = 0; i < count; i++) {
+		xcb_get_window_attributes_reply_t *attributes = xcb_get_window_attributes_reply(connection, attributeCookies[i], NULL);
+		xcb_get_geometry_reply_t *geometry = xcb_get_geometry_reply(connection, geometryCookies[i], NULL);
+		xcb_get_property_reply_t *hints = xcb_get_property_reply(connection, hintsCookies[i], NULL);
+		xcb_get_property_reply_t *name = xcb_get_property_reply(connection, nameCookies[i], NULL);
+		xcb_get_property_reply_t *netName = xcb_get_property_reply(connection, netNameCookies[i], NULL);
+		xcb_query_tree_reply_t *tree = xcb_query_tree_reply(connection, treeCookies[i], NULL);
+		xcb_get_property_reply_t *protocols = xcb_get_property_reply(connection, protocolsCookies[i], NULL);
+		xcb_get_property_reply_t *counter = xcb_get_property_reply(connection, counterCookies[i], NULL);
+
+		if (attributes && geometry && (!viewableOnly ||
+			isClaimable(attributes->map_state == XCB_MAP_STATE_VIEWABLE ? IsViewable : IsUnviewable,
+						attributes->_class == XCB_WINDOW_CLASS_INPUT_ONLY ? InputOnly : InputOutput,
+						attributes->override_redirect))) {
+			ClaimInfo *info = &infos[claimable++];
+
+			memset(info, 0, sizeof(ClaimInfo));
+			info->window = windows[i];
+			info->x = geometry->x;
+			info->y = geometry->y;
+			info->width = geometry->width;
+			info->height = geometry->height;
+			info->border_width = geometry->border_width;
+
+			if (hints) {
+				parseSizeHints(hints, info);
+			}
+
+			/* Prefer the EWMH name, which isn't limited to Latin-1 */
+			if (netName && netName->format == 8 && xcb_get_property_value_length(netName) > 0) {
+				info->title = titleFromUTF8(xcb_get_property_value(netName), xcb_get_property_value_length(netName));
+			}
+			else if (name && name->format == 8 && xcb_get_property_value_length(name) > 0) {
+				info->title = copyTitle(xcb_get_property_value(name), xcb_get_property_value_length(name));
+			}
+
+			if (tree) {
+				info->nchildren = xcb_query_tree_children_length(tree);
+				info->children = copyXCBChildren(xcb_query_tree_children(tree), info->nchildren);
+			}
+
+			if (protocols) {
+				info->protocols = parseProtocols(protocols);
+			}
+
+			/* The counter only counts if WM_PROTOCOLS says the client will update it */
+			if ((info->protocols & ProtocolSyncRequest) && counter &&
+				counter->format == 32 && xcb_get_property_value_length(counter) == 4) {
+				info->syncCounter = *(uint32_t *)xcb_get_property_value(counter);
+			}
+		}
+
+		free(attributes);
+		free(geometry);
+		free(hints);
+		free(name);
+		free(netName);
+		free(tree);
+		free(protocols);
+		free(counter);
+	}
+
+	free(attributeCookies);
+	free(geometryCookies);
+	free(hintsCookies);
+	free(nameCookies);
+	free(netNameCookies);
+	free(treeCookies);
+	free(protocolsCookies);
+	free(counterCookies);
+
+	return claimable;
+}
+
+int fetchClaimInfo(Display *display, Window window, ClaimInfo *info) {
+	memset(info, 0, sizeof(ClaimInfo));
+	return fetchPipelinedClaimInfo(display, &window, 1, info, 0);
+}
+
+unsigned int fetchAllClaimInfo(Display *display, const Window *windows, unsigned int count, ClaimInfo *infos) {
+	return fetchPipelinedClaimInfo(display, windows, count, infos, 1);
+}
+#else
+static Window *copyChildren(const Window *children, unsigned int nchildren) {
+	if (!nchildren) {
+		return NULL;
+	}
+
+	Window *copy = malloc(nchildren * sizeof(Window));
+	assert(copy);
+	memcpy(copy, children, nchildren * sizeof(Window));
+	return copy;
+}
+
+static void fetchRemainingClaimInfo(Display *display, Window window, const XWindowAttributes *attr, ClaimInfo *info) {
+	Window root;
+	Window parent;
+	Window *children;
+
+	memset(info, 0, sizeof(ClaimInfo));
+	info->window = window;
+	info->x = attr->x;
+	info->y = attr->y;
+	info->width = attr->width;
+	info->height = attr->height;
+	info->border_width = attr->border_width;
+
+	if (!XGetWMNormalHints(display, window, &info->hints, &info->supplied_hints)) {
+		info->supplied_hints = 0;
+	}
+
+	info->title = fetchWindowTitle(display, window);
+
+	if (XQueryTree(display, window, &root, &parent, &children, &info->nchildren)) {
+		info->children = copyChildren(children, info->nchildren);
+		if (children) {
+			XFree(children);
+		}
+	}
+
+	/* The counter only counts if WM_PROTOCOLS says the client will update it */
+	info->protocols = fetchWindowProtocols(display, window);
+	if (info->protocols & ProtocolSyncRequest) {
+		info->syncCounter = fetchSyncCounter(display, window);
+	}
+}
+
+int fetchClaimInfo(Display *display, Window window, ClaimInfo *info) {
+	XWindowAttributes attr;
+
+	memset(info, 0, sizeof(ClaimInfo));
+	if (!XGetWindowAttributes(display, window, &attr)) {
+		return 0;
+	}
+
+	fetchRemainingClaimInfo(display, window, &attr, info);
+	return 1;
+}
+
+unsigned int fetchAllClaimInfo(Display *display, const Window *windows, unsigned int count, ClaimInfo *infos) {
+	XWindowAttributes attr;
+	unsigned int claimable = 0;
+	unsigned int i;
+
+	/* Without XCB every query is a round trip, but at least skip what we won't decorate */
+	for (i = 0; i < count; i++) {
+		if (XGetWindowAttributes(display, windows[i], &attr) &&
+			isClaimable(attr.map_state, attr.class, attr.override_redirect)) {
+			fetchRemainingClaimInfo(display, windows[i], &attr, &infos[claimable++]);
+		}
+	}
+
+	return claimable;
+}
+#endif
+
+void freeClaimInfo(ClaimInfo *info) {
+	free(info->title);
+	free(info->children);
+	info->title = NULL;
+	info->children = NULL;
+	info->nchildren = 0;
+}
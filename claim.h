@@ -0,0 +1,57 @@
+/*
+ * Copyright (c) 2012 Daniel Loffgren
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+#ifndef classic_wm_claim_h
+#define classic_wm_claim_h
+
+#include <X11/Xlib.h>
+#include <X11/Xutil.h> /* XSizeHints */
+
+/* Everything claimWindow() needs to know about a window, fetched ahead of time */
+struct ClaimInfo_t {
+	Window window;
+	int x;
+	int y;
+	unsigned int width;
+	unsigned int height;
+	unsigned int border_width;
+
+	XSizeHints hints;
+	long supplied_hints;
+
+	char *title;
+	Window *children;
+	unsigned int nchildren;
+
+	/* Protocol flags, and the _NET_WM_SYNC_REQUEST counter if that's one of them */
+	int protocols;
+	XID syncCounter;
+};
+
+typedef struct ClaimInfo_t ClaimInfo;
+
+int fetchClaimInfo(Display *display, Window window, ClaimInfo *info);
+unsigned int fetchAllClaimInfo(Display *display, const Window *windows, unsigned int count, ClaimInfo *infos);
+void freeClaimInfo(ClaimInfo *info);
+
+#endif
@@ -22,12 +22,15 @@
 
 #include <assert.h>
 #include <err.h>
+#include <stdlib.h>
 #include <string.h>
 #include "decorations.h"
+#include "resources.h"
 
-static unsigned long white;
-static unsigned long black;
-static XFontStruct *font;
+/* These expect a display to be in scope, like the RECT_ macros expect attr */
+#define SCREEN_RESOURCES           resourcesForScreen(display, DefaultScreen(display))
+#define WHITE                      (SCREEN_RESOURCES->white)
+#define BLACK                      (SCREEN_RESOURCES->black)
 
 int pointIsInRect(const int px, const int py, const int rx, const int ry, int rw, int rh) {
 	rw++;
@@ -36,48 +39,62 @@ int pointIsInRect(const int px, const int py, const int rx, const int ry, int rw
 	        (py >= ry && py <= (ry + rh)));
 }
 
-Window decorateWindow(Display *display, Drawable window, Window root, GC gc, const int x, const int y, const int width, const int height, Window *resizer) {
+static int framePolicy;
+
+void setFrameStorePolicy(Display *display, int screen, int policy) {
+	Screen *s = ScreenOfDisplay(display, screen);
+
+	/* The request still goes out, servers just ignore what they don't do */
+	if ((policy & FrameStoreBacking) && DoesBackingStore(s) == NotUseful) {
+		warnx("This server has no backing store, -b backing does nothing");
+	}
+	if ((policy & FrameStoreSaveUnder) && !DoesSaveUnders(s)) {
+		warnx("This server has no save-unders, -b saveunder does nothing");
+	}
+	framePolicy = policy;
+}
+
+void setFrameSaveUnder(Display *display, Window decorationWindow, int saveUnder) {
+	XSetWindowAttributes attrib;
+
+	if (framePolicy & FrameStoreSaveUnder) {
+		attrib.save_under = saveUnder ? True : False;
+		XChangeWindowAttributes(display, decorationWindow, CWSaveUnder, &attrib);
+	}
+}
+
+Window decorateWindow(Display *display, Drawable window, Window root, const int x, const int y, const int width, const int height, const int borderWidth, Window *resizer) {
 	Window newParent;
 	XSetWindowAttributes attrib;
 	XWindowAttributes attr;
-	XWindowAttributes incomingAttribs;
-	char *title;
-
-	/* This is entirely for window border compensation */
-	/* FIXME: This _works_, but looks like crap for anything with more than a 1px border, in the future this should do up to one pixel and start adjusting the container window for the remainder */
-	XGetWindowAttributes(display, window, &incomingAttribs);
 
 	attr.width = width;
 	attr.height = height + TITLEBAR_THICKNESS;
 
 	/* Flag as override_redirect, so that we don't decorate decorations */
 	attrib.override_redirect = 1;
+	attrib.backing_store = WhenMapped;
 
 	/* Create New Parent */
-	newParent = XCreateWindow(display, root, x, y, width + FRAME_HORIZONTAL_THICKNESS, height + FRAME_VERTICAL_THICKNESS, 0, CopyFromParent, InputOutput, CopyFromParent, CWOverrideRedirect, &attrib);
-	XReparentWindow(display, window, newParent, FRAME_LEFT_THICKNESS - incomingAttribs.border_width, TITLEBAR_THICKNESS - incomingAttribs.border_width);
+	newParent = XCreateWindow(display, root, x, y, width + FRAME_HORIZONTAL_THICKNESS, height + FRAME_VERTICAL_THICKNESS, 0, CopyFromParent, InputOutput, CopyFromParent,
+							  CWOverrideRedirect | ((framePolicy & FrameStoreBacking) ? CWBackingStore : 0), &attrib);
+
+	/* This is entirely for window border compensation */
+	/* FIXME: This _works_, but looks like crap for anything with more than a 1px border, in the future this should do up to one pixel and start adjusting the container window for the remainder */
+	XReparentWindow(display, window, newParent, FRAME_LEFT_THICKNESS - borderWidth, TITLEBAR_THICKNESS - borderWidth);
+
+	/* A client claimed on MapRequest isn't mapped yet, and now appears along with its frame */
+	XMapWindow(display, window);
 
 	/* Create Resize Button Window */
 	*resizer = XCreateWindow(display, newParent, RECT_RESIZE_BTN, 0, CopyFromParent, CopyFromParent, CopyFromParent, 0, 0);
 	XMapRaised(display, *resizer);
 
 	/* Set Cursor */
-	Cursor cur = XCreateFontCursor(display, XC_left_ptr);
-	XDefineCursor(display, newParent, cur);
+	XDefineCursor(display, newParent, SCREEN_RESOURCES->cursor);
 
-	/* Readjust attributes to now refer to the decoration window */
-	attr.width += FRAME_HORIZONTAL_THICKNESS;
-	attr.height += FRAME_BOTTOM_THICKNESS;
-
-	/* Draw Time! */
+	/* Painted by the next flush, see claimWindow() */
 	XMapWindow(display, newParent);
-	XFetchName(display, window, &title);
-	drawDecorations(display, newParent, gc, title, attr, 1);
-	drawResizeButton(display, *resizer, gc, RECT_RESIZE_DRAW);
-
-	if (title) {
-		XFree(title);
-	}
 
 	return newParent;
 }
@@ -89,179 +106,513 @@ void undecorateWindow(Display *display, Window decorationWindow, Window resizer)
 	XDestroyWindow(display, decorationWindow);
 }
 
-static void whiteOutTitleBar(Display *display, Drawable window, GC gc, XWindowAttributes attr){
-	XSetForeground(display, gc, white);
-	XFillRectangle(display, window, gc, 1, 1, attr.width - FRAME_HORIZONTAL_THICKNESS, TITLEBAR_THICKNESS - 2);
+static void drawStripes(Canvas *canvas, XWindowAttributes attr);
+
+static void setRect(XRectangle *rect, const int x, const int y, const int w, const int h) {
+	rect->x = x;
+	rect->y = y;
+	rect->width = w;
+	rect->height = h;
+}
+
+/* Single primitives, for the painters that only ever draw one at a time */
+static void fillRect(Canvas *canvas, CanvasColor color, const int x, const int y, const int w, const int h) {
+	XRectangle rect;
+	setRect(&rect, x, y, w, h);
+	canvas->ops->fillRectangles(canvas, color, &rect, 1);
+}
+
+static void strokeRect(Canvas *canvas, CanvasColor color, const int x, const int y, const int w, const int h) {
+	XRectangle rect;
+	setRect(&rect, x, y, w, h);
+	canvas->ops->drawRectangles(canvas, color, &rect, 1);
+}
+
+static void strokeLine(Canvas *canvas, CanvasColor color, const int x1, const int y1, const int x2, const int y2) {
+	XSegment segment;
+	segment.x1 = x1;
+	segment.y1 = y1;
+	segment.x2 = x2;
+	segment.y2 = y2;
+	canvas->ops->drawSegments(canvas, color, &segment, 1);
+}
+
+/* A NULL damage region means everything is damaged */
+static int isDamaged(Region damage, const int x, const int y, const int w, const int h) {
+	return !damage || XRectInRegion(damage, x, y, w, h) != RectangleOut;
 }
 
-void drawDecorations(Display *display, Drawable window, GC gc, const char *title, XWindowAttributes attr, const int focused) {
-	if (!white || !black) {
-		white = XWhitePixel(display, DefaultScreen(display));
-		black = XBlackPixel(display, DefaultScreen(display));
+/* Buttons white out a little beyond their own rect, see whiteOutUnderButton */
+static int buttonIsDamaged(Region damage, const int x, const int y, const int w, const int h) {
+	return isDamaged(damage, x - 1, y, w + 3, h + 1);
+}
+
+void setTitleLayoutTitle(TitleLayout *layout, const char *title) {
+	free(layout->prefixWidths);
+	memset(layout, 0, sizeof(TitleLayout));
+
+	layout->title = title;
+	layout->titleLength = title ? (int)strlen(title) : 0;
+	layout->frameWidth = -1;
+}
+
+void releaseTitleLayout(TitleLayout *layout) {
+	setTitleLayoutTitle(layout, NULL);
+}
+
+static void layoutTitle(const int *advances, TitleLayout *layout, const int frameWidth) {
+	const int available = frameWidth - 42 - (2 * TITLEBAR_TEXT_MARGIN);
+	int width;
+	int i;
+
+	if (layout->frameWidth == frameWidth) {
+		return;
 	}
+	layout->frameWidth = frameWidth;
+	layout->length = 0;
+	layout->ellipsized = 0;
 
-	/* Draw bounding box */
-	whiteOutTitleBar(display, window, gc, attr);
-	XSetForeground(display, gc, black);
-	XDrawRectangle(display, window, gc, RECT_TITLEBAR);
+	if (!layout->title) {
+		return;
+	}
 
-	if (focused) {
-		/* Draw texture */
-		int y;
-		for (y = TITLEBAR_TEXTURE_START; y < TITLEBAR_TEXTURE_START + TITLEBAR_CONTROL_SIZE; y += TITLEBAR_TEXTURE_SPACE) {
-			XDrawLine(display, window, gc, 2, y, attr.width - 4, y);
+	if (!layout->prefixWidths) {
+		layout->prefixWidths = malloc((layout->titleLength + 1) * sizeof(int));
+		assert(layout->prefixWidths);
+
+		layout->prefixWidths[0] = 0;
+		for (i = 0; i < layout->titleLength; i++) {
+			layout->prefixWidths[i + 1] = layout->prefixWidths[i] + advances[(unsigned char)layout->title[i]];
+		}
+	}
+
+	width = layout->prefixWidths[layout->titleLength];
+	if (width <= available) {
+		layout->length = layout->titleLength;
+	}
+	else {
+		/* Find the longest prefix that still leaves room for the ellipsis */
+		const char *dot = TITLE_ELLIPSIS;
+		int ellipsis = 0;
+		int low = 0;
+		int high = layout->titleLength;
+
+		for (; *dot; dot++) {
+			ellipsis += advances[(unsigned char)*dot];
+		}
+		while (low < high) {
+			const int mid = (low + high + 1) / 2;
+			if (layout->prefixWidths[mid] + ellipsis <= available) {
+				low = mid;
+			}
+			else {
+				high = mid - 1;
+			}
 		}
+		while (low && layout->title[low - 1] == ' ') {
+			low--;
+		}
+
+		/* If not even one character fits, don't bother drawing it, just bail */
+		if (!low) {
+			return;
+		}
+
+		layout->length = low;
+		layout->ellipsized = 1;
+		width = layout->prefixWidths[low] + ellipsis;
 	}
 
-	/* White out areas for buttons and title */
-	XSetForeground(display, gc, white);
-	/* Subwindow box */
-	XFillRectangle(display, window, gc,
+	setRect(&layout->bounds, ((frameWidth - width)/ 2) - TITLEBAR_TEXT_MARGIN, 4, width + (2 * TITLEBAR_TEXT_MARGIN), TITLEBAR_CONTROL_SIZE);
+}
+
+static int layoutBounds(const int *advances, TitleLayout *title, XWindowAttributes attr, XRectangle *bounds) {
+	layoutTitle(advances, title, attr.width);
+	if (!title->length) {
+		return 0;
+	}
+
+	*bounds = title->bounds;
+	return 1;
+}
+
+int titleBounds(Display *display, TitleLayout *title, XWindowAttributes attr, XRectangle *bounds) {
+	return layoutBounds(SCREEN_RESOURCES->advances, title, attr, bounds);
+}
+
+int titleBoundsOnCanvas(Canvas *canvas, TitleLayout *title, XWindowAttributes attr, XRectangle *bounds) {
+	return layoutBounds(canvas->advances, title, attr, bounds);
+}
+
+static void drawTitleInRegion(Canvas *canvas, TitleLayout *title, XWindowAttributes attr, Region damage) {
+	XRectangle bounds;
+	XTextItem items[2];
+
+	if (!layoutBounds(canvas->advances, title, attr, &bounds) ||
+		!isDamaged(damage, bounds.x, bounds.y, bounds.width, bounds.height)) {
+		return;
+	}
+
+	/* White out under Title */
+	canvas->ops->fillRectangles(canvas, CanvasWhite, &bounds, 1);
+
+	/* Draw title, and the ellipsis right after it in the same request */
+	items[0].chars = (char *)title->title;
+	items[0].nchars = title->length;
+	items[0].delta = 0;
+	items[0].font = None;
+	items[1].chars = TITLE_ELLIPSIS;
+	items[1].nchars = (int)strlen(TITLE_ELLIPSIS);
+	items[1].delta = 0;
+	items[1].font = None;
+	canvas->ops->drawText(canvas, bounds.x + TITLEBAR_TEXT_MARGIN, TITLEBAR_TEXT_OFFSET, items, title->ellipsized ? 2 : 1);
+}
+
+void drawDecorations(Display *display, Drawable window, GC gc, TitleLayout *title, XWindowAttributes attr, const int focused) {
+	drawDecorationsInRegion(display, window, gc, title, attr, focused, NULL);
+}
+
+void drawDecorationsInRegion(Display *display, Drawable window, GC gc, TitleLayout *title, XWindowAttributes attr, const int focused, Region damage) {
+	Canvas canvas;
+	initXlibCanvas(&canvas, display, window, gc);
+	drawDecorationsOnCanvas(&canvas, title, attr, focused, damage);
+}
+
+void drawDecorationsOnCanvas(Canvas *canvas, TitleLayout *title, XWindowAttributes attr, const int focused, Region damage) {
+	XRectangle whiteRects[2];
+	XRectangle blackRects[2];
+	int rects = 0;
+
+	/*
+	 * The caller is expected to have clipped the GC to the damage, so each
+	 * piece only has to be skipped when it can't possibly be affected.
+	 */
+	const int titlebarDamaged = isDamaged(damage, 0, 0, attr.width - 1, TITLEBAR_THICKNESS);
+	const int bodyDamaged = isDamaged(damage, 0, TITLEBAR_THICKNESS - FRAME_TUCK_INSET, attr.width - 1, attr.height - TITLEBAR_THICKNESS);
+
+	if (titlebarDamaged) {
+		/* Titlebar background and bounding box */
+		setRect(&whiteRects[rects], 1, 1, attr.width - FRAME_HORIZONTAL_THICKNESS, TITLEBAR_THICKNESS - 2);
+		setRect(&blackRects[rects], RECT_TITLEBAR);
+		rects++;
+	}
+	if (bodyDamaged) {
+		/* Subwindow box, and the same box with each edge tucked in */
+		setRect(&whiteRects[rects],
 				FRAME_RIGHT_THICKNESS,
 				TITLEBAR_THICKNESS,
 				attr.width - FRAME_HORIZONTAL_THICKNESS,
 				attr.height - FRAME_VERTICAL_THICKNESS - 1); /* FIXME: Is this extra 1 necessary? */
-
-	/* Draw buttons and title */
-	XSetForeground(display, gc, black);
-	/* Subwindow box with each edge tucked in */
-	XDrawRectangle(display, window, gc,
+		setRect(&blackRects[rects],
 				FRAME_LEFT_THICKNESS - FRAME_TUCK_INSET,
 				TITLEBAR_THICKNESS - FRAME_TUCK_INSET,
 				attr.width - FRAME_LEFT_THICKNESS - FRAME_TUCK_INSET,
 				attr.height - TITLEBAR_THICKNESS - FRAME_TUCK_INSET);
-	/* Shadow */
-	XDrawLine(display, window, gc, 1, attr.height - 1, attr.width, attr.height - 1); /* bottom */
-	XDrawLine(display, window, gc, attr.width - 1, attr.height - 1, attr.width - 1, 1); /* left */
+		rects++;
+	}
 
-	/* White out the shadow ends */
-	XSetForeground(display, gc, white);
-	XDrawPoint(display, window, gc, 0, attr.height - 1); /* bottom left */
-	XDrawPoint(display, window, gc, attr.width - 1, 0); /* top right */
-	XSetForeground(display, gc, black);
+	if (rects) {
+		canvas->ops->fillRectangles(canvas, CanvasWhite, whiteRects, rects);
+		canvas->ops->drawRectangles(canvas, CanvasBlack, blackRects, rects);
+	}
+
+	if (focused && titlebarDamaged) {
+		drawStripes(canvas, attr);
+	}
+
+	/* Shadow, bottom and right edges */
+	if (isDamaged(damage, 0, attr.height - 1, attr.width, 1) || isDamaged(damage, attr.width - 1, 0, 1, attr.height)) {
+		XSegment shadow[2];
+		XPoint ends[2];
+
+		shadow[0].x1 = 1;                shadow[0].y1 = attr.height - 1; /* bottom */
+		shadow[0].x2 = attr.width;       shadow[0].y2 = attr.height - 1;
+		shadow[1].x1 = attr.width - 1;   shadow[1].y1 = attr.height - 1; /* left */
+		shadow[1].x2 = attr.width - 1;   shadow[1].y2 = 1;
+		canvas->ops->drawSegments(canvas, CanvasBlack, shadow, 2);
+
+		/* White out the shadow ends */
+		ends[0].x = 0;                   ends[0].y = attr.height - 1; /* bottom left */
+		ends[1].x = attr.width - 1;      ends[1].y = 0; /* top right */
+		canvas->ops->drawPoints(canvas, CanvasWhite, ends, 2);
+	}
 
 	/* Draw Title */
-	drawTitle(display, window, gc, title, attr);
+	drawTitleInRegion(canvas, title, attr, damage);
 
 	if (focused) {
 		/* Draw Close Button */
-		drawCloseButton(display, window, gc, RECT_CLOSE_BTN);
+		if (buttonIsDamaged(damage, RECT_CLOSE_BTN)) {
+			drawCloseButtonOnCanvas(canvas, RECT_CLOSE_BTN);
+		}
 
 		/* Draw Maximize Button */
-		drawMaximizeButton(display, window, gc, RECT_MAX_BTN);
+		if (buttonIsDamaged(damage, RECT_MAX_BTN)) {
+			drawMaximizeButtonOnCanvas(canvas, RECT_MAX_BTN);
+		}
 
 #if COLLAPSE_BUTTON_ENABLED
 		/* Draw Collapse Button */
-		drawCollapseButton(display, window, gc, RECT_COLLAPSE_BTN);
+		if (buttonIsDamaged(damage, RECT_COLLAPSE_BTN)) {
+			drawCollapseButtonOnCanvas(canvas, RECT_COLLAPSE_BTN);
+		}
 #endif
 	}
 }
 
-void drawTitle(Display *display, Drawable window, GC gc, const char *title, XWindowAttributes attr){
-	int twidth;
-
-	if (title) {
-		/* Set up text */
-		if (!font) {
-			font = XLoadQueryFont(display, TITLEBAR_FONTNAME);
-			if (!font) {
-				warnx("unable to load preferred font: " TITLEBAR_FONTNAME " using fixed");
-				font = XLoadQueryFont(display, "fixed");
-				assert(font);
-			}
-		}
-		XSetFont(display, gc, font->fid);
-		twidth = XTextWidth(font, title, (int)strlen(title));
+void drawTitle(Display *display, Drawable window, GC gc, TitleLayout *title, XWindowAttributes attr){
+	Canvas canvas;
+	initXlibCanvas(&canvas, display, window, gc);
+	drawTitleOnCanvas(&canvas, title, attr);
+}
 
-		/* If the title wont fit, don't bother drawing it, just bail */
-		if (attr.width < (twidth + 42 + (2 * TITLEBAR_TEXT_MARGIN))) {
-			return;
-		}
+void drawTitleOnCanvas(Canvas *canvas, TitleLayout *title, XWindowAttributes attr) {
+	drawTitleInRegion(canvas, title, attr, NULL);
+}
 
-		/* White out under Title */
-		XSetForeground(display, gc, white);
-		XFillRectangle(display, window, gc,
-					((attr.width - twidth)/ 2) - TITLEBAR_TEXT_MARGIN,
-					4,
-					twidth + (2 * TITLEBAR_TEXT_MARGIN),
-					TITLEBAR_CONTROL_SIZE);
-
-		/* Draw title */
-		XSetForeground(display, gc, black);
-		XSetBackground(display, gc, white);
-		XDrawString(display, window, gc, ((attr.width - twidth)/ 2), TITLEBAR_TEXT_OFFSET, title, (int)strlen(title));
-	}
+void drawOutline(Display *display, Window root, GC outlineGC, const int x, const int y, const int width, const int height) {
+	/* The frame, and the bottom of its titlebar, as one request */
+	XSegment segments[5];
+	const int right = x + width - 1;
+	const int bottom = y + height - 1;
+	const int titlebar = y + TITLEBAR_THICKNESS - 1;
+
+	/* Each segment stops short of the next corner, so no pixel is XORed twice */
+	segments[0].x1 = x;         segments[0].y1 = y;        segments[0].x2 = right - 1; segments[0].y2 = y;
+	segments[1].x1 = right;     segments[1].y1 = y;        segments[1].x2 = right;     segments[1].y2 = bottom - 1;
+	segments[2].x1 = right;     segments[2].y1 = bottom;   segments[2].x2 = x + 1;     segments[2].y2 = bottom;
+	segments[3].x1 = x;         segments[3].y1 = bottom;   segments[3].x2 = x;         segments[3].y2 = y + 1;
+	segments[4].x1 = x + 1;     segments[4].y1 = titlebar; segments[4].x2 = right - 1; segments[4].y2 = titlebar;
+	XDrawSegments(display, root, outlineGC, segments, titlebar < bottom ? 5 : 4);
 }
 
 void whiteOutUnderButton(Display *display, Drawable window, GC gc, const int x, const int y, const int w, const int h){
+	Canvas canvas;
+	initXlibCanvas(&canvas, display, window, gc);
+	whiteOutUnderButtonOnCanvas(&canvas, x, y, w, h);
+}
+
+void whiteOutUnderButtonOnCanvas(Canvas *canvas, const int x, const int y, const int w, const int h) {
 	/* White out bg */
-	XSetForeground(display, gc, white);
-	XFillRectangle(display, window, gc, x - 1, y, w + 3, h + 1);
+	fillRect(canvas, CanvasWhite, x - 1, y, w + 3, h + 1);
 }
 
-void drawResizeButton(Display *display, Drawable window, GC gc, const int x, const int y, const int w, const int h) {
-	whiteOutUnderButton(display, window, gc, x, y, w, h);
+static void renderResizeButton(Canvas *canvas, const int x, const int y, const int w, const int h) {
+	whiteOutUnderButtonOnCanvas(canvas, x, y, w, h);
 
 	/* Draw Border */
-	XSetForeground(display, gc, black);
-	XDrawRectangle(display, window, gc, x, y, w, h);
+	strokeRect(canvas, CanvasBlack, x, y, w, h);
 
 	/* Bottom box */
-	XDrawRectangle(display, window, gc, x + 5, y + 5, 8, 8);
+	strokeRect(canvas, CanvasBlack, x + 5, y + 5, 8, 8);
 
 	/* Top box */
-	XDrawRectangle(display, window, gc, x + 3, y + 3, 6, 6);
+	strokeRect(canvas, CanvasBlack, x + 3, y + 3, 6, 6);
 
 	/* White out overlap */
-	XSetForeground(display, gc, white);
-	XFillRectangle(display, window, gc, x + 4, y + 4, 5, 5);
+	fillRect(canvas, CanvasWhite, x + 4, y + 4, 5, 5);
 }
 
-void drawMaximizeButton(Display *display, Drawable window, GC gc, const int x, const int y, const int w, const int h) {
-	whiteOutUnderButton(display, window, gc, x, y, w, h);
+static void renderMaximizeButton(Canvas *canvas, const int x, const int y, const int w, const int h) {
+	whiteOutUnderButtonOnCanvas(canvas, x, y, w, h);
 
 	/* Draw Border */
-	XSetForeground(display, gc, black);
-	XDrawRectangle(display, window, gc, x, y, w, h);
+	strokeRect(canvas, CanvasBlack, x, y, w, h);
 
 	/* Draw Inside */
-	XDrawRectangle(display, window, gc, x, y, w / 2, h / 2);
+	strokeRect(canvas, CanvasBlack, x, y, w / 2, h / 2);
 }
 
-void drawCloseButton(Display *display, Drawable window, GC gc, const int x, const int y, const int w, const int h) {
-	whiteOutUnderButton(display, window, gc, x, y, w, h);
+static void renderCloseButton(Canvas *canvas, const int x, const int y, const int w, const int h) {
+	whiteOutUnderButtonOnCanvas(canvas, x, y, w, h);
 
 	/* Draw Border */
-	XSetForeground(display, gc, black);
-	XDrawRectangle(display, window, gc, x, y, w, h);
+	strokeRect(canvas, CanvasBlack, x, y, w, h);
 }
 
-void drawCollapseButton(Display *display, Drawable window, GC gc, const int x, const int y, const int w, const int h) {
-	whiteOutUnderButton(display, window, gc, x, y, w, h);
+static void renderCollapseButton(Canvas *canvas, const int x, const int y, const int w, const int h) {
+	whiteOutUnderButtonOnCanvas(canvas, x, y, w, h);
 
 	/* Draw Border */
-	XSetForeground(display, gc, black);
-	XDrawRectangle(display, window, gc, x, y, w, h);
+	strokeRect(canvas, CanvasBlack, x, y, w, h);
 
-	XDrawRectangle(display, window, gc, x, y + w / 2 - 1, w, 2);
+	strokeRect(canvas, CanvasBlack, x, y + w / 2 - 1, w, 2);
 }
 
-void drawCloseButtonDown(Display *display, Drawable window, GC gc, const int x, const int y, const int w, const int h) {
-	drawCloseButton(display, window, gc, x, y, w, h);
+static void renderCloseButtonDown(Canvas *canvas, const int x, const int y, const int w, const int h) {
+	renderCloseButton(canvas, x, y, w, h);
 
 	/* Draw first diag */
-	XDrawLine(display, window, gc, x + 2, y + 2, x + w - 2, y + h - 2);
+	strokeLine(canvas, CanvasBlack, x + 2, y + 2, x + w - 2, y + h - 2);
 
 	/* Draw | */
-	XDrawLine(display, window, gc, x + w / 2, y, x + w / 2, y + h);
+	strokeLine(canvas, CanvasBlack, x + w / 2, y, x + w / 2, y + h);
 
 	/* Draw - */
-	XDrawLine(display, window, gc, x, y + h / 2, x + w, y + h / 2);
+	strokeLine(canvas, CanvasBlack, x, y + h / 2, x + w, y + h / 2);
 
 	/* Draw / */
-	XDrawLine(display, window, gc, x + w - 2, y + 2, x + 2, y + h - 2);
+	strokeLine(canvas, CanvasBlack, x + w - 2, y + 2, x + 2, y + h - 2);
 
 	/* Remove Center */
-	XSetForeground(display, gc, white);
-	XFillRectangle(display, window, gc, x + w / 2 - 1, y + h / 2 - 1, 3, 3);
+	fillRect(canvas, CanvasWhite, x + w / 2 - 1, y + h / 2 - 1, 3, 3);
+}
+
+/*
+ * Every button (and the resizer) is pre-rendered once into the atlas,
+ * including the white margin whiteOutUnderButton() would paint, so that a
+ * redraw is a single XCopyArea. Anything asked for at a size the atlas
+ * doesn't have still gets rendered the slow way.
+ */
+#define BUTTON_SIZE                (TITLEBAR_CONTROL_SIZE - 1)
+
+typedef enum {
+	AtlasCloseButton = 0,
+	AtlasMaximizeButton,
+	AtlasCollapseButton,
+	AtlasButtonDown,
+	AtlasResizeButton,
+	AtlasEntryCount
+} AtlasEntry;
+
+static struct {
+	Pixmap entries[AtlasEntryCount];
+	Pixmap stripes;
+} atlas;
+
+static const struct {
+	canvasDecorationFunction *render;
+	int size;
+} atlasEntries[AtlasEntryCount] = {
+	{ renderCloseButton,     BUTTON_SIZE },
+	{ renderMaximizeButton,  BUTTON_SIZE },
+	{ renderCollapseButton,  BUTTON_SIZE },
+	{ renderCloseButtonDown, BUTTON_SIZE },
+	{ renderResizeButton,    RESIZE_CONTROL_SIZE },
+};
+
+static Pixmap createAtlasPixmap(Display *display, unsigned int width, unsigned int height) {
+	const int screen = DefaultScreen(display);
+	countResource(ResourceTypePixmap, 1);
+	return XCreatePixmap(display, RootWindow(display, screen), width, height, DefaultDepth(display, screen));
+}
+
+void loadDecorationAtlas(Display *display, GC gc) {
+	int i;
+
+	/* The GC must not be clipped yet, or the atlas would be too */
+	if (atlas.stripes) {
+		return;
+	}
+
+	for (i = 0; i < AtlasEntryCount; i++) {
+		const int size = atlasEntries[i].size;
+		Canvas canvas;
+
+		atlas.entries[i] = createAtlasPixmap(display, size + 3, size + 1);
+		initXlibCanvas(&canvas, display, atlas.entries[i], gc);
+		atlasEntries[i].render(&canvas, 1, 0, size, size);
+	}
+
+	/* One titlebar tall, so that the rows line up with the titlebar when tiled from the origin */
+	atlas.stripes = createAtlasPixmap(display, 16, TITLEBAR_THICKNESS);
+	XSetForeground(display, gc, WHITE);
+	XFillRectangle(display, atlas.stripes, gc, 0, 0, 16, TITLEBAR_THICKNESS);
+	XSetForeground(display, gc, BLACK);
+	for (i = TITLEBAR_TEXTURE_START; i < TITLEBAR_TEXTURE_START + TITLEBAR_CONTROL_SIZE; i += TITLEBAR_TEXTURE_SPACE) {
+		XDrawLine(display, atlas.stripes, gc, 0, i, 15, i);
+	}
+
+	/* The tile only takes effect while the fill style is FillTiled */
+	XSetTile(display, gc, atlas.stripes);
+}
+
+void releaseDecorationAtlas(Display *display) {
+	int i;
+
+	if (!atlas.stripes) {
+		return;
+	}
+
+	for (i = 0; i < AtlasEntryCount; i++) {
+		XFreePixmap(display, atlas.entries[i]);
+		countResource(ResourceTypePixmap, -1);
+	}
+	XFreePixmap(display, atlas.stripes);
+	countResource(ResourceTypePixmap, -1);
+	memset(&atlas, 0, sizeof(atlas));
+}
+
+static void blitAtlasEntry(AtlasEntry entry, Canvas *canvas, const int x, const int y, const int w, const int h) {
+	const int size = atlasEntries[entry].size;
+
+	if (atlas.stripes && canvas->ops->copyPixmap && w == size && h == size) {
+		canvas->ops->copyPixmap(canvas, atlas.entries[entry], size + 3, size + 1, x - 1, y);
+	}
+	else {
+		atlasEntries[entry].render(canvas, x, y, w, h);
+	}
+}
+
+static void drawStripes(Canvas *canvas, XWindowAttributes attr) {
+	if (atlas.stripes && canvas->ops->fillTiled) {
+		/* The stripe tile lines up with the titlebar */
+		canvas->ops->fillTiled(canvas, 2, TITLEBAR_TEXTURE_START, attr.width - 5, TITLEBAR_CONTROL_SIZE);
+	}
+	else {
+		int y;
+		for (y = TITLEBAR_TEXTURE_START; y < TITLEBAR_TEXTURE_START + TITLEBAR_CONTROL_SIZE; y += TITLEBAR_TEXTURE_SPACE) {
+			strokeLine(canvas, CanvasBlack, 2, y, attr.width - 4, y);
+		}
+	}
+}
+
+void drawResizeButton(Display *display, Drawable window, GC gc, const int x, const int y, const int w, const int h) {
+	Canvas canvas;
+	initXlibCanvas(&canvas, display, window, gc);
+	drawResizeButtonOnCanvas(&canvas, x, y, w, h);
+}
+
+void drawResizeButtonOnCanvas(Canvas *canvas, const int x, const int y, const int w, const int h) {
+	blitAtlasEntry(AtlasResizeButton, canvas, x, y, w, h);
+}
+
+void drawMaximizeButton(Display *display, Drawable window, GC gc, const int x, const int y, const int w, const int h) {
+	Canvas canvas;
+	initXlibCanvas(&canvas, display, window, gc);
+	drawMaximizeButtonOnCanvas(&canvas, x, y, w, h);
+}
+
+void drawMaximizeButtonOnCanvas(Canvas *canvas, const int x, const int y, const int w, const int h) {
+	blitAtlasEntry(AtlasMaximizeButton, canvas, x, y, w, h);
+}
+
+void drawCloseButton(Display *display, Drawable window, GC gc, const int x, const int y, const int w, const int h) {
+	Canvas canvas;
+	initXlibCanvas(&canvas, display, window, gc);
+	drawCloseButtonOnCanvas(&canvas, x, y, w, h);
+}
+
+void drawCloseButtonOnCanvas(Canvas *canvas, const int x, const int y, const int w, const int h) {
+	blitAtlasEntry(AtlasCloseButton, canvas, x, y, w, h);
+}
+
+void drawCollapseButton(Display *display, Drawable window, GC gc, const int x, const int y, const int w, const int h) {
+	Canvas canvas;
+	initXlibCanvas(&canvas, display, window, gc);
+	drawCollapseButtonOnCanvas(&canvas, x, y, w, h);
+}
+
+void drawCollapseButtonOnCanvas(Canvas *canvas, const int x, const int y, const int w, const int h) {
+	blitAtlasEntry(AtlasCollapseButton, canvas, x, y, w, h);
+}
+
+void drawCloseButtonDown(Display *display, Drawable window, GC gc, const int x, const int y, const int w, const int h) {
+	Canvas canvas;
+	initXlibCanvas(&canvas, display, window, gc);
+	drawCloseButtonDownOnCanvas(&canvas, x, y, w, h);
+}
+
+void drawCloseButtonDownOnCanvas(Canvas *canvas, const int x, const int y, const int w, const int h) {
+	blitAtlasEntry(AtlasButtonDown, canvas, x, y, w, h);
 }
@@ -24,8 +24,11 @@
 #define _decorations_h
 
 #include <X11/Xlib.h>
+#include <X11/Xutil.h> /* Region */
 #include <X11/extensions/Xdbe.h>
 
+#include "canvas.h"
+
 /* Titlebar Font */
 #define TITLEBAR_FONTNAME       "-*-Chicago-*-*-*--12-*-*-*-*-*-*-*"
 
@@ -76,15 +79,59 @@
 	XdbeEndIdiom(display); \
 }
 
+/*
+ * What the server keeps of frames for us, see -b. Backing store spares a
+ * frame the Expose when something moves off it, and a save-under on the
+ * frame being dragged spares everything underneath it.
+ */
+typedef enum {
+	FrameStoreNone = 0,
+	FrameStoreBacking = 1 << 0,
+	FrameStoreSaveUnder = 1 << 1
+} FrameStorePolicy;
+
+void setFrameStorePolicy(Display *display, int screen, int policy);
+void setFrameSaveUnder(Display *display, Window decorationWindow, int saveUnder);
+
+
+/* Titles */
+#define TITLE_ELLIPSIS             "..."
+
+/*
+ * How a title fits in a titlebar, measured once per title, and laid out
+ * again only when the frame width changes. A new width costs one search of
+ * the prefix widths, so resizing never has to measure text.
+ */
+struct TitleLayout_t {
+	const char *title;
+	int titleLength;
+	int *prefixWidths;         /* px width of the first n characters, for n up to titleLength */
+
+	int frameWidth;            /* the width this is laid out for, -1 when stale */
+	int length;                /* characters drawn, 0 if even an ellipsis won't fit */
+	int ellipsized;
+	XRectangle bounds;         /* the white box behind the text */
+};
+
+typedef struct TitleLayout_t TitleLayout;
+
+void setTitleLayoutTitle(TitleLayout *layout, const char *title);
+void releaseTitleLayout(TitleLayout *layout);
 
 /* Functions */
-Window decorateWindow(Display *display, Drawable window, Window root, GC gc, int x, int y, int width, int height, Window *resizer);
+Window decorateWindow(Display *display, Drawable window, Window root, int x, int y, int width, int height, int borderWidth, Window *resizer);
 void undecorateWindow(Display *display, Window decorationWindow, Window resizer);
-void drawDecorations(Display *display, Drawable window, GC gc, const char *title, XWindowAttributes attr, int focused);
-void drawTitle(Display *display, Drawable window, GC gc, const char *title, XWindowAttributes attr);
+void drawDecorations(Display *display, Drawable window, GC gc, TitleLayout *title, XWindowAttributes attr, int focused);
+void drawDecorationsInRegion(Display *display, Drawable window, GC gc, TitleLayout *title, XWindowAttributes attr, int focused, Region damage);
+void drawTitle(Display *display, Drawable window, GC gc, TitleLayout *title, XWindowAttributes attr);
+int titleBounds(Display *display, TitleLayout *title, XWindowAttributes attr, XRectangle *bounds);
+void drawOutline(Display *display, Window root, GC outlineGC, int x, int y, int width, int height);
 int pointIsInRect(int px, int py, int rx, int ry, int rw, int rh);
+void loadDecorationAtlas(Display *display, GC gc);
+void releaseDecorationAtlas(Display *display);
 
 typedef void (decorationFunction)(Display *display, Drawable window, GC gc, int x, int y, int w, int h);
+typedef void (canvasDecorationFunction)(Canvas *canvas, int x, int y, int w, int h);
 
 /* Individual Decorations */
 void whiteOutUnderButton(Display *display, Drawable window, GC gc, int x, int y, int w, int h);
@@ -94,4 +141,19 @@ void drawMaximizeButton(Display *display, Drawable window, GC gc, int x, int y,
 void drawResizeButton(Display *display, Drawable window, GC gc, int x, int y, int w, int h);
 void drawCollapseButton(Display *display, Drawable window, GC gc, int x, int y, int w, int h);
 
+/*
+ * Everything above draws through an Xlib canvas, these draw on any canvas.
+ * Canvases other than Xlib don't have the atlas, so buttons are rendered
+ * from scratch on them, pixel for pixel the same.
+ */
+void drawDecorationsOnCanvas(Canvas *canvas, TitleLayout *title, XWindowAttributes attr, int focused, Region damage);
+void drawTitleOnCanvas(Canvas *canvas, TitleLayout *title, XWindowAttributes attr);
+int titleBoundsOnCanvas(Canvas *canvas, TitleLayout *title, XWindowAttributes attr, XRectangle *bounds);
+void whiteOutUnderButtonOnCanvas(Canvas *canvas, int x, int y, int w, int h);
+void drawCloseButtonOnCanvas(Canvas *canvas, int x, int y, int w, int h);
+void drawCloseButtonDownOnCanvas(Canvas *canvas, int x, int y, int w, int h);
+void drawMaximizeButtonOnCanvas(Canvas *canvas, int x, int y, int w, int h);
+void drawResizeButtonOnCanvas(Canvas *canvas, int x, int y, int w, int h);
+void drawCollapseButtonOnCanvas(Canvas *canvas, int x, int y, int w, int h);
+
 #endif
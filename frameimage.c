@@ -0,0 +1,400 @@
+/*
+ * Copyright (c) 2012 Daniel Loffgren
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/* shmget() and friends are XSI, and hidden by -std=c89 otherwise */
+#define _XOPEN_SOURCE 500
+
+#include <err.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#include <X11/extensions/XShm.h>
+
+#include "frameimage.h"
+#include "raster.h"
+#include "resources.h"
+
+#define MAX(a, b) ((a) > (b) ? (a) : (b))
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+
+typedef struct {
+	XImage *image;
+	XShmSegmentInfo info;
+	int busy;                  /* until the ShmCompletion for its last put */
+} ShmBuffer;
+
+static int enabled;
+static int useShm;
+static int completionType;
+static int attachFailed;
+static Canvas canvas;
+static RasterFont font;
+static ShmBuffer buffers[FRAME_IMAGE_BUFFERS];
+static unsigned int nextBuffer;
+static unsigned char reversed[256];    /* bit reversal, for servers that want LSBFirst bitmaps */
+
+/* Copies the title font's glyphs off the server once, so the raster canvas can draw real text */
+static int loadRasterFont(Display *display, Window root, const XFontStruct *xfont) {
+	const int origin = MAX(-xfont->min_bounds.lbearing, 0);
+	const int cellWidth = MAX(origin + xfont->max_bounds.rbearing, 1);
+	const int width = 256 * cellWidth;
+	const int height = xfont->ascent + xfont->descent;
+	XGCValues values;
+	XImage *image;
+	Pixmap pixmap;
+	GC gc;
+	int x;
+	int y;
+
+	font.stride = (width + 7) / 8;
+	font.bits = calloc(height, font.stride);
+	if (!font.bits) {
+		return 0;
+	}
+	font.cellWidth = cellWidth;
+	font.origin = origin;
+	font.ascent = xfont->ascent;
+	font.descent = xfont->descent;
+
+	pixmap = XCreatePixmap(display, root, width, height, 1);
+	values.foreground = 0;
+	values.font = xfont->fid;
+	values.graphics_exposures = False;
+	gc = XCreateGC(display, pixmap, GCForeground | GCFont | GCGraphicsExposures, &values);
+	XFillRectangle(display, pixmap, gc, 0, 0, width, height);
+	XSetForeground(display, gc, 1);
+	for (x = 0; x < 256; x++) {
+		char c = (char)x;
+		XDrawString(display, pixmap, gc, x * cellWidth + origin, font.ascent, &c, 1);
+	}
+
+	image = XGetImage(display, pixmap, 0, 0, width, height, 1, XYPixmap);
+	XFreeGC(display, gc);
+	XFreePixmap(display, pixmap);
+	if (!image) {
+		free(font.bits);
+		memset(&font, 0, sizeof(font));
+		return 0;
+	}
+
+	for (y = 0; y < height; y++) {
+		for (x = 0; x < width; x++) {
+			if (XGetPixel(image, x, y)) {
+				font.bits[y * font.stride + (x >> 3)] |= 0x80 >> (x & 7);
+			}
+		}
+	}
+	XDestroyImage(image);
+
+	return 1;
+}
+
+int enableFrameImages(Display *display, int screen) {
+	ScreenResources *res = resourcesForScreen(display, screen);
+	int i;
+
+	if (!loadRasterFont(display, RootWindow(display, screen), res->font)) {
+		return 0;
+	}
+
+	for (i = 0; i < 256; i++) {
+		int bit;
+		for (bit = 0; bit < 8; bit++) {
+			if (i & (1 << bit)) {
+				reversed[i] |= 0x80 >> bit;
+			}
+		}
+	}
+
+	useShm = XShmQueryExtension(display);
+	completionType = useShm ? XShmGetEventBase(display) + ShmCompletion : 0;
+	enabled = 1;
+
+	return 1;
+}
+
+int frameImagesEnabled(void) {
+	return enabled;
+}
+
+static int catchAttachError(Display *display, XErrorEvent *error) {
+	(void)display;
+	(void)error;
+	attachFailed = 1;
+	return 0;
+}
+
+static void releaseBuffer(Display *display, ShmBuffer *buffer) {
+	if (!buffer->image) {
+		return;
+	}
+
+	/* The image doesn't own the segment, so it mustn't free it */
+	XShmDetach(display, &buffer->info);
+	buffer->image->data = NULL;
+	XDestroyImage(buffer->image);
+	shmdt(buffer->info.shmaddr);
+	memset(buffer, 0, sizeof(ShmBuffer));
+}
+
+/* Returns 0 if shared memory turns out not to work, which it won't over a network */
+static int createBuffer(Display *display, ShmBuffer *buffer, int width, int height) {
+	const int screen = DefaultScreen(display);
+	int (*previous)(Display *, XErrorEvent *);
+	XImage *image;
+
+	image = XShmCreateImage(display, DefaultVisual(display, screen), 1, XYBitmap, NULL, &buffer->info, width, height);
+	if (!image) {
+		return 0;
+	}
+
+	/* The canvas is copied a byte at a time, which needs bytes laid out in bit order */
+	if (image->bitmap_unit != 8 && image->bitmap_bit_order != image->byte_order) {
+		XDestroyImage(image);
+		return 0;
+	}
+
+	buffer->info.shmid = shmget(IPC_PRIVATE, image->bytes_per_line * image->height, IPC_CREAT | 0600);
+	if (buffer->info.shmid < 0) {
+		XDestroyImage(image);
+		return 0;
+	}
+	buffer->info.shmaddr = image->data = shmat(buffer->info.shmid, NULL, 0);
+	buffer->info.readOnly = True;
+
+	attachFailed = 0;
+	previous = XSetErrorHandler(catchAttachError);
+	if (buffer->info.shmaddr != (char *)-1) {
+		XShmAttach(display, &buffer->info);
+		XSync(display, False);
+	}
+	XSetErrorHandler(previous);
+
+	/* Once the server has it, the segment can go away as soon as both of us let go */
+	shmctl(buffer->info.shmid, IPC_RMID, NULL);
+
+	if (buffer->info.shmaddr == (char *)-1 || attachFailed) {
+		if (buffer->info.shmaddr != (char *)-1) {
+			shmdt(buffer->info.shmaddr);
+		}
+		image->data = NULL;
+		XDestroyImage(image);
+		memset(buffer, 0, sizeof(ShmBuffer));
+		return 0;
+	}
+
+	buffer->image = image;
+	return 1;
+}
+
+static ShmBuffer *bufferForSegment(ShmSeg segment) {
+	int i;
+
+	for (i = 0; i < FRAME_IMAGE_BUFFERS; i++) {
+		if (buffers[i].image && buffers[i].info.shmseg == segment) {
+			return &buffers[i];
+		}
+	}
+	return NULL;
+}
+
+static Bool isCompletionFor(Display *display, XEvent *event, XPointer buffer) {
+	(void)display;
+	return event->type == completionType &&
+		((XShmCompletionEvent *)event)->shmseg == ((ShmBuffer *)buffer)->info.shmseg;
+}
+
+static ShmBuffer *availableBuffer(Display *display, int width, int height) {
+	ShmBuffer *buffer = NULL;
+	unsigned int i;
+
+	/* Completions read by earlier event handling usually leave one free */
+	for (i = 0; i < FRAME_IMAGE_BUFFERS && !buffer; i++) {
+		ShmBuffer *candidate = &buffers[(nextBuffer + i) % FRAME_IMAGE_BUFFERS];
+		if (!candidate->busy) {
+			buffer = candidate;
+		}
+	}
+	if (!buffer) {
+		XEvent completion;
+
+		/* Everything else stays queued for the event loop */
+		buffer = &buffers[nextBuffer % FRAME_IMAGE_BUFFERS];
+		XIfEvent(display, &completion, isCompletionFor, (XPointer)buffer);
+		buffer->busy = 0;
+	}
+	nextBuffer = (buffer - buffers + 1) % FRAME_IMAGE_BUFFERS;
+
+	if (buffer->image && (buffer->image->width < width || buffer->image->height < height)) {
+		releaseBuffer(display, buffer);
+	}
+	if (!buffer->image && !createBuffer(display, buffer, width, height)) {
+		warnx("MIT-SHM is unavailable, putting frame images over the connection");
+		useShm = 0;
+		return NULL;
+	}
+
+	return buffer;
+}
+
+static void putShm(Display *display, Drawable drawable, GC gc, const XRectangle *box) {
+	ShmBuffer *buffer = availableBuffer(display, canvas.width, canvas.height);
+	const int first = box->x >> 3;
+	const int last = (box->x + box->width - 1) >> 3;
+	const int lsb = buffer ? buffer->image->bitmap_bit_order == LSBFirst : 0;
+	int y;
+
+	if (!buffer) {
+		return;
+	}
+
+	for (y = box->y; y < box->y + box->height; y++) {
+		const unsigned char *from = &canvas.bits[y * canvas.stride];
+		unsigned char *to = (unsigned char *)&buffer->image->data[y * buffer->image->bytes_per_line];
+		int i;
+
+		if (lsb) {
+			for (i = first; i <= last; i++) {
+				to[i] = reversed[from[i]];
+			}
+		}
+		else {
+			memcpy(&to[first], &from[first], last - first + 1);
+		}
+	}
+
+	buffer->busy = 1;
+	XShmPutImage(display, drawable, gc, buffer->image, box->x, box->y, box->x, box->y, box->width, box->height, True);
+}
+
+static void putPlain(Display *display, Drawable drawable, GC gc, const XRectangle *box) {
+	const int screen = DefaultScreen(display);
+
+	/* Xlib converts to whatever the server wants as it copies the image into the request */
+	XImage *image = XCreateImage(display, DefaultVisual(display, screen), 1, XYBitmap, 0, (char *)canvas.bits,
+								 canvas.width, canvas.height, 8, canvas.stride);
+	if (!image) {
+		return;
+	}
+	image->bitmap_unit = 8;
+	image->bitmap_bit_order = MSBFirst;
+	image->byte_order = MSBFirst;
+
+	XPutImage(display, drawable, gc, image, box->x, box->y, box->x, box->y, box->width, box->height);
+	image->data = NULL;
+	XDestroyImage(image);
+}
+
+static int fitCanvas(Display *display, int width, int height) {
+	if (canvas.bits && canvas.width >= width && canvas.height >= height) {
+		return 1;
+	}
+
+	/* Buffers are only ever grown, to the biggest frame yet */
+	width = MAX(width, canvas.width);
+	height = MAX(height, canvas.height);
+	releaseRasterCanvas(&canvas);
+	if (!createRasterCanvas(&canvas, width, height, resourcesForScreen(display, DefaultScreen(display))->advances)) {
+		return 0;
+	}
+	setRasterFont(&canvas, &font);
+
+	return 1;
+}
+
+void putFrameImage(Display *display, Drawable drawable, GC gc, TitleLayout *title, XWindowAttributes attr, const int focused, Region damage) {
+	XRectangle box;
+
+	if (attr.width <= 0 || attr.height <= 0 || !fitCanvas(display, attr.width, attr.height)) {
+		return;
+	}
+
+	/* Everything is drawn, so wherever the put comes from is this frame */
+	box.x = 0;
+	box.y = 0;
+	box.width = attr.width;
+	box.height = attr.height;
+	canvas.ops->fillRectangles(&canvas, CanvasWhite, &box, 1);
+	drawDecorationsOnCanvas(&canvas, title, attr, focused, NULL);
+
+	/* But only the damage is put, the GC clips it the rest of the way */
+	if (damage) {
+		XRectangle extents;
+		int right;
+		int bottom;
+
+		XClipBox(damage, &extents);
+		right = MIN(extents.x + extents.width, attr.width);
+		bottom = MIN(extents.y + extents.height, attr.height);
+		box.x = MAX(extents.x, 0);
+		box.y = MAX(extents.y, 0);
+		if (right <= box.x || bottom <= box.y) {
+			return;
+		}
+		box.width = right - box.x;
+		box.height = bottom - box.y;
+	}
+
+	/* Set bits are drawn in the foreground, the rest in the background, which is always white */
+	XSetForeground(display, gc, resourcesForScreen(display, DefaultScreen(display))->black);
+	if (useShm) {
+		putShm(display, drawable, gc, &box);
+	}
+	if (!useShm) {
+		putPlain(display, drawable, gc, &box);
+	}
+}
+
+int handleFrameImageEvent(const XEvent *event) {
+	ShmBuffer *buffer;
+
+	if (!completionType || event->type != completionType) {
+		return 0;
+	}
+
+	/* The server is done reading the segment, so it can be drawn into again */
+	buffer = bufferForSegment(((const XShmCompletionEvent *)event)->shmseg);
+	if (buffer) {
+		buffer->busy = 0;
+	}
+	return 1;
+}
+
+void releaseFrameImages(Display *display) {
+	int i;
+
+	if (!enabled) {
+		return;
+	}
+
+	for (i = 0; i < FRAME_IMAGE_BUFFERS; i++) {
+		releaseBuffer(display, &buffers[i]);
+	}
+	releaseRasterCanvas(&canvas);
+	free(font.bits);
+	memset(&font, 0, sizeof(font));
+	enabled = 0;
+	completionType = 0;
+}
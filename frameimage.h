@@ -0,0 +1,51 @@
+/*
+ * Copyright (c) 2012 Daniel Loffgren
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef classic_wm_frameimage_h
+#define classic_wm_frameimage_h
+
+#include <X11/Xlib.h>
+#include <X11/Xutil.h> /* Region */
+
+#include "decorations.h"
+
+/*
+ * Frame images, see -u: each redraw is rasterized on the client (see
+ * raster.h) and put with one request, however much there is to draw. The
+ * image goes through MIT-SHM when the server shares memory with us, and
+ * through XPutImage otherwise. FRAME_IMAGE_BUFFERS segments take turns, so
+ * a put never waits on the server unless all of them are still being read.
+ */
+#define FRAME_IMAGE_BUFFERS        (2)
+
+/* Returns 0 if the title font can't be copied, shared memory is optional */
+int enableFrameImages(Display *display, int screen);
+int frameImagesEnabled(void);
+void releaseFrameImages(Display *display);
+
+/* Stands in for drawDecorationsInRegion(), the GC is expected to be clipped to the damage too */
+void putFrameImage(Display *display, Drawable drawable, GC gc, TitleLayout *title, XWindowAttributes attr, int focused, Region damage);
+
+/* Returns whether the event was one of our ShmCompletions, which need nothing else */
+int handleFrameImageEvent(const XEvent *event);
+
+#endif
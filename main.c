@@ -20,20 +20,38 @@
  * IN THE SOFTWARE.
  */
 
+/* getopt() is POSIX, and hidden by -std=c89 otherwise */
+#define _POSIX_C_SOURCE 200112L
+
 #include <assert.h>
 #include <err.h>       /* warnx */
 #include <stdarg.h>    /* va_list */
+#include <stdio.h>     /* fprintf */
 #include <stdlib.h>    /* getenv */
+#include <string.h>    /* strcmp */
 #include <sysexits.h>  /* EX_UNAVAILABLE */
 #include <time.h>      /* time() */
+#include <unistd.h>    /* getopt */
 #include <X11/Xlib.h>
 #include <X11/Xutil.h> /* XSizeHints */
 
+#include "atoms.h"
+#include "background.h"
+#include "claim.h"
 #include "eventnames.h"
 #include "decorations.h"
+#include "frameimage.h"
 #include "pool.h"
+#include "properties.h"
+#include "resources.h"
+#include "stats.h"
+#include "syncrequest.h"
+#include "timing.h"
+#include "tombstone.h"
+#include "trace.h"
 
 #define MAX(a, b) ((a) > (b) ? (a) : (b))
+#define DEFAULT_FRAME_RATE (60)    /* Hz, see -r */
 #define NEW_WINDOW_OFFSET 0 /*((XDisplayWidth(display, DefaultScreen(display)) > 2560) ? 0 : 22) */
 
 typedef enum {
@@ -47,97 +65,447 @@ typedef enum {
 	MouseDownStateResize
 } MouseDownState;
 
-/* HACK: Find a better way to eat the extraneous Expose events on destruction of decorations */
-static Window decorationWindowDestroyed;
-static Window resizerDestroyed;
+/* Replaying a trace, see -R */
+static int replaying;
+static unsigned long replayErrors;
+
+/*
+ * Drag latency, from the server timestamp of the newest motion to the flush
+ * that sends its configure. Server time is in milliseconds on its own clock,
+ * so the offset to ours is taken from the ButtonPress that starts the drag.
+ */
+static struct {
+	double offset;          /* currentTime() minus server time at ButtonPress */
+	double pending;         /* server time of the newest unflushed motion, 0 if none */
+	unsigned long samples;
+	double total;
+	double worst;
+} dragLatency;
+
+static void beginDragLatency(Time serverTime) {
+	dragLatency.offset = currentTime() - serverTime / 1000.0;
+	dragLatency.pending = 0;
+	dragLatency.samples = 0;
+	dragLatency.total = 0;
+	dragLatency.worst = 0;
+}
+
+static void sampleDragLatency(double now) {
+	/* A replay's motions carry the recorded server time, which has nothing to do with ours */
+	if (!dragLatency.pending || replaying) {
+		return;
+	}
+
+	const double latency = now - (dragLatency.pending + dragLatency.offset);
+	countDragLatency(latency);
+	dragLatency.total += latency;
+	if (latency > dragLatency.worst) {
+		dragLatency.worst = latency;
+	}
+	dragLatency.samples++;
+	dragLatency.pending = 0;
+}
+
+/* Outline drags, see -o */
+static int outlineMode;
+static struct {
+	int shown;
+	int x;
+	int y;
+	int width;
+	int height;
+} outline;
+
+/* Frames waiting on the swap at the end of flushDirtyWindows() */
+static SwapBatch swapBatch;
+
+/* Applies one dimension of the client's WM_NORMAL_HINTS to a client length */
+static int constrainClientLength(int length, int min, int max, int base, int inc) {
+	if (max && length > max) {
+		length = max;
+	}
+
+	/* Clients with increments (terminals) only come in whole steps past their base size */
+	if (inc > 1 && length > base) {
+		length -= (length - base) % inc;
+	}
+
+	return MAX(length, min);
+}
+
+static void constrainFrameSize(const ManagedWindow *mw, int *w, int *h) {
+	/* Respect the window's size hints, which are for the client inside the frame */
+	*w = constrainClientLength(*w - FRAME_HORIZONTAL_THICKNESS, mw->min_w, mw->max_w, mw->base_w, mw->inc_w) + FRAME_HORIZONTAL_THICKNESS;
+	*h = constrainClientLength(*h - FRAME_VERTICAL_THICKNESS, mw->min_h, mw->max_h, mw->base_h, mw->inc_h) + FRAME_VERTICAL_THICKNESS;
 
-static void resizeWindow(Display *display, ManagedWindow *mw, int w, int h) {
 	/* Set some absolute minimums */
-	w = MAX(w, ((TITLEBAR_CONTROL_SIZE) * 5));
-	h = MAX(h, ((TITLEBAR_THICKNESS) * 2) + RESIZE_CONTROL_SIZE);
-
-	/* Respect the window minimums, if they exist */
-	w = MAX(w, mw->min_w);
-	h = MAX(h, mw->min_h);
-
-	/* Size the decorations as requested, and inset the actual window */
-	XResizeWindow(display, mw->decorationWindow, w, h);
-	XResizeWindow(display, mw->actualWindow, w - FRAME_HORIZONTAL_THICKNESS, h - FRAME_VERTICAL_THICKNESS);
-	XMoveWindow(display, mw->resizer, w - RESIZE_CONTROL_SIZE - FRAME_RIGHT_THICKNESS, h - RESIZE_CONTROL_SIZE - FRAME_BOTTOM_THICKNESS);
-}
-
-static void lowerAllWindowsInPool(Display *display, ManagedWindowPool *pool, GC gc) {
-	ManagedWindow *this;
-	SLIST_FOREACH(this, &pool->windows, entries) {
-		if (this != pool->active) {
-			XWindowAttributes attr;
-			XGetWindowAttributes(display, this->decorationWindow, &attr);
-			DRAW_ACTION(display, this->decorationWindow, {
-				drawDecorations(display, this->decorationBuffer, gc, this->title, attr, 0);
+	*w = MAX(*w, ((TITLEBAR_CONTROL_SIZE) * 5));
+	*h = MAX(*h, ((TITLEBAR_THICKNESS) * 2) + RESIZE_CONTROL_SIZE);
+}
+
+static void resizeWindow(ManagedWindowPool *pool, ManagedWindow *mw, int w, int h) {
+	constrainFrameSize(mw, &w, &h);
+
+	/* Size the decorations as requested, and inset the actual window, at the next frame */
+	mw->width = w;
+	mw->height = h;
+	mw->client_w = w - FRAME_HORIZONTAL_THICKNESS;
+	mw->client_h = h - FRAME_VERTICAL_THICKNESS;
+	markWindowDirty(mw, DirtySize | DirtyClientSize | DirtyDecorations | DirtyResizer, pool);
+}
+
+static void moveWindow(ManagedWindowPool *pool, ManagedWindow *mw, int x, int y) {
+	mw->x = x;
+	mw->y = y;
+	markWindowDirty(mw, DirtyPosition, pool);
+}
+
+/* Moves the rubber band, erasing it from where it was, since it is XORed */
+static void showOutline(Display *display, Window root, GC outlineGC, int x, int y, int w, int h) {
+	if (outline.shown) {
+		if (outline.x == x && outline.y == y && outline.width == w && outline.height == h) {
+			return;
+		}
+		drawOutline(display, root, outlineGC, outline.x, outline.y, outline.width, outline.height);
+	}
+
+	outline.x = x;
+	outline.y = y;
+	outline.width = w;
+	outline.height = h;
+	outline.shown = 1;
+	drawOutline(display, root, outlineGC, x, y, w, h);
+}
+
+static void hideOutline(Display *display, Window root, GC outlineGC) {
+	if (outline.shown) {
+		drawOutline(display, root, outlineGC, outline.x, outline.y, outline.width, outline.height);
+		outline.shown = 0;
+	}
+}
+
+/* Brings the cached property up to date, and redraws only what it affects */
+static void refreshProperty(Display *display, ManagedWindow *mw, Atom property, ManagedWindowPool *pool) {
+	XWindowAttributes attr = frameAttributes(mw);
+	XRectangle oldTitle;
+	XRectangle newTitle;
+	const int hadTitle = titleBounds(display, &mw->titleLayout, attr, &oldTitle);
+	const int changed = refreshWindowProperty(display, mw, property);
+
+	if (changed & PropertyTitle) {
+		/* Both where the old title was, and where the new one goes */
+		if (!mw->damage) {
+			mw->damage = XCreateRegion();
+		}
+		if (hadTitle) {
+			XUnionRectWithRegion(&oldTitle, mw->damage, mw->damage);
+		}
+		if (titleBounds(display, &mw->titleLayout, attr, &newTitle)) {
+			XUnionRectWithRegion(&newTitle, mw->damage, mw->damage);
+		}
+		markWindowDirty(mw, DirtyDamage, pool);
+	}
+
+	if (changed & PropertySyncCounter) {
+		unwatchSyncCounter(display, mw, pool);
+		if (mw->protocols & ProtocolSyncRequest) {
+			watchSyncCounter(display, mw, fetchSyncCounter(display, mw->actualWindow), pool);
+		}
+	}
+}
+
+/* Sends everything deferred for this window: at most one configure and one repaint */
+static void paintFrame(Display *display, Drawable drawable, GC gc, ManagedWindow *mw, XWindowAttributes attr, ManagedWindowPool *pool, Region damage) {
+	if (frameImagesEnabled()) {
+		putFrameImage(display, drawable, gc, &mw->titleLayout, attr, (mw == pool->active), damage);
+	}
+	else {
+		drawDecorationsInRegion(display, drawable, gc, &mw->titleLayout, attr, (mw == pool->active), damage);
+	}
+}
+
+/* Double buffers the frame for a while, unless the server paints it from its background anyway */
+static void animateFrame(Display *display, ManagedWindow *mw, ManagedWindowPool *pool) {
+	if (!frameBackgroundsEnabled()) {
+		acquireBackBuffer(display, mw, pool);
+	}
+}
+
+/* With a batch, the swap waits for the rest of the frame, see flushDirtyWindows() */
+static void flushWindow(Display *display, GC gc, ManagedWindow *mw, ManagedWindowPool *pool, SwapBatch *batch) {
+	const int dirty = mw->dirty;
+	int deferred = 0;
+	markWindowClean(mw, pool);
+
+	if ((dirty & DirtyPosition) && (dirty & DirtySize)) {
+		XMoveResizeWindow(display, mw->decorationWindow, mw->x, mw->y, mw->width, mw->height);
+	}
+	else if (dirty & DirtyPosition) {
+		XMoveWindow(display, mw->decorationWindow, mw->x, mw->y);
+	}
+	else if (dirty & DirtySize) {
+		XResizeWindow(display, mw->decorationWindow, mw->width, mw->height);
+	}
+
+	/* A collapsed window keeps its client (unmapped) at the uncollapsed size */
+	if ((dirty & DirtySize) && !mw->collapsed) {
+		XMoveWindow(display, mw->resizer, mw->width - RESIZE_CONTROL_SIZE - FRAME_RIGHT_THICKNESS, mw->height - RESIZE_CONTROL_SIZE - FRAME_BOTTOM_THICKNESS);
+	}
+
+	/* The frame follows the pointer, but the client only gets a size once it has caught up */
+	if ((dirty & DirtyClientSize) && !mw->collapsed) {
+		const double now = currentTime();
+		if (clientMayResize(mw, now)) {
+			prepareClientResize(display, mw, now);
+			XResizeWindow(display, mw->actualWindow, mw->client_w, mw->client_h);
+		}
+		else {
+			deferred |= DirtyClientSize;
+		}
+	}
+
+	if ((dirty & (DirtyDecorations | DirtyDamage)) && frameBackgroundsEnabled()) {
+		/*
+		 * The server repaints exposures from the background by itself, so
+		 * damage here only comes from a new title, and goes into the pixmap.
+		 */
+		XWindowAttributes attr = frameAttributes(mw);
+		if ((dirty & DirtyDecorations) || !mw->background) {
+			mw->redraws++;
+			paintFrame(display, frameBackgroundForPainting(display, mw), gc, mw, attr, pool, NULL);
+			showFrameBackground(display, mw);
+		}
+		else if (mw->damage) {
+			mw->redraws++;
+			XSetRegion(display, gc, mw->damage);
+			paintFrame(display, mw->background, gc, mw, attr, pool, mw->damage);
+			XSetClipMask(display, gc, None);
+			showFrameBackground(display, mw);
+		}
+
+		if (mw->damage) {
+			XDestroyRegion(mw->damage);
+			mw->damage = NULL;
+		}
+	}
+	else if (dirty & (DirtyDecorations | DirtyDamage)) {
+		XWindowAttributes attr = frameAttributes(mw);
+		Region damage = (dirty & DirtyDecorations) ? NULL : mw->damage;
+
+		/* Redraw only what was damaged (if that's all), based on active or not */
+		if (damage) {
+			XSetRegion(display, gc, damage);
+		}
+		mw->redraws++;
+		if (!(dirty & DirtyDecorations)) {
+			countStat(StatExposePainted);
+		}
+		if (mw->decorationBuffer && batch) {
+			touchBackBuffer(mw);
+			paintFrame(display, mw->decorationBuffer, gc, mw, attr, pool, damage);
+			queueSwap(batch, mw->decorationWindow);
+		}
+		else if (mw->decorationBuffer) {
+			touchBackBuffer(mw);
+			DRAW_ACTION(display, mw->decorationWindow, {
+				paintFrame(display, mw->decorationBuffer, gc, mw, attr, pool, damage);
 			});
-			XGrabButton(display, 0, AnyModifier, this->actualWindow, 0, ButtonPressMask, GrabModeAsync, GrabModeAsync, None, None);
+			countStat(StatSwaps);
+		}
+		else {
+			/* Nothing is animating this frame, so a single paint can't flicker */
+			paintFrame(display, mw->decorationWindow, gc, mw, attr, pool, damage);
 		}
+		if (damage) {
+			XSetClipMask(display, gc, None);
+		}
+
+		if (mw->damage) {
+			XDestroyRegion(mw->damage);
+			mw->damage = NULL;
+		}
+	}
+
+	if (dirty & DirtyResizer) {
+		drawResizeButton(display, mw->resizer, gc, RECT_RESIZE_DRAW);
+	}
+
+	/* Held back work stays on the dirty list, and is retried next frame */
+	if (deferred) {
+		markWindowDirty(mw, deferred, pool);
+	}
+}
+
+static void flushDirtyWindows(Display *display, GC gc, ManagedWindowPool *pool) {
+	ManagedWindow *mw = SLIST_FIRST(&pool->dirty);
+
+	/* Every frame repainted now flips in one request, so a focus change never shows half done */
+	XdbeBeginIdiom(display);
+
+	/* Windows that defer work go back on the head of the list, behind this walk */
+	while (mw) {
+		ManagedWindow *next = SLIST_NEXT(mw, dirtyEntries);
+		flushWindow(display, gc, mw, pool, &swapBatch);
+		mw = next;
+	}
+
+	if (swapQueuedBuffers(display, &swapBatch)) {
+		countStat(StatSwaps);
+	}
+	XdbeEndIdiom(display);
+}
+
+/* One frame: configure and repaint everything dirty, keeping the rubber band out of any repaint underneath it */
+static void flushFrame(Display *display, Window root, GC gc, GC outlineGC, ManagedWindowPool *pool) {
+	const int outlineShown = outline.shown;
+
+	hideOutline(display, root, outlineGC);
+	flushDirtyWindows(display, gc, pool);
+	countStat(StatFrames);
+	if (outlineShown) {
+		showOutline(display, root, outlineGC, outline.x, outline.y, outline.width, outline.height);
 	}
+	sampleDragLatency(currentTime());
 }
 
-static void focusWindow(Display *display, ManagedWindow *mw, GC gc, ManagedWindowPool *pool) {
+static void setButtonGrab(Display *display, ManagedWindow *mw, int grabbed) {
+	/* Passive grabs are only installed or removed when they actually change */
+	if (mw->grabbed == grabbed) {
+		return;
+	}
+
+	if (grabbed) {
+		XGrabButton(display, 0, AnyModifier, mw->actualWindow, 0, ButtonPressMask, GrabModeAsync, GrabModeAsync, None, None);
+	}
+	else {
+		XUngrabButton(display, 0, AnyModifier, mw->actualWindow);
+	}
+	mw->grabbed = grabbed;
+}
+
+/* Focuses a window without double buffering the change, for windows that were just claimed */
+static void activateWindow(Display *display, ManagedWindow *mw, ManagedWindowPool *pool) {
+	ManagedWindow *previous = pool->active;
 	pool->active = mw;
-	lowerAllWindowsInPool(display, pool, gc);
-	XRaiseWindow(display, mw->decorationWindow);
-	XUngrabButton(display, 0, AnyModifier, mw->actualWindow);
+
+	/* Only the window losing focus and the one gaining it have anything to change */
+	if (previous != mw) {
+		if (previous) {
+			markWindowDirty(previous, DirtyDecorations, pool);
+			setButtonGrab(display, previous, 1);
+		}
+		markWindowDirty(mw, DirtyDecorations, pool);
+	}
+
+	/* Most clicks land on the frame that is already on top, which needs no restack */
+	raiseWindowInPool(display, mw, pool);
+	setButtonGrab(display, mw, 0);
 
 	/* If the window is collapsed, move input focus to the decoration window */
 	Window windowToFocus = mw->collapsed ? mw->decorationWindow : mw->actualWindow;
 	XSetInputFocus(display, windowToFocus, RevertToNone, CurrentTime);
 }
 
-static void collapseWindow(Display *display, ManagedWindowPool *pool, ManagedWindow *mw, GC gc) {
-	XWindowAttributes attr;
+/* Focuses a window the user picked, animating both frames that change */
+static void focusWindow(Display *display, ManagedWindow *mw, ManagedWindowPool *pool) {
+	if (pool->active != mw) {
+		if (pool->active) {
+			animateFrame(display, pool->active, pool);
+		}
+		animateFrame(display, mw, pool);
+	}
+	activateWindow(display, mw, pool);
+}
+
+/* ICCCM 4.1.5: a client whose size didn't change still hears where it is, in root coordinates */
+static void sendSyntheticConfigure(Display *display, ManagedWindow *mw) {
+	XEvent ev;
+
+	memset(&ev, 0, sizeof(ev));
+	ev.xconfigure.type = ConfigureNotify;
+	ev.xconfigure.event = mw->actualWindow;
+	ev.xconfigure.window = mw->actualWindow;
+	ev.xconfigure.x = mw->x + FRAME_LEFT_THICKNESS - mw->border_width;
+	ev.xconfigure.y = mw->y + TITLEBAR_THICKNESS - mw->border_width;
+	ev.xconfigure.width = mw->client_w;
+	ev.xconfigure.height = mw->client_h;
+	ev.xconfigure.border_width = mw->border_width;
+	ev.xconfigure.above = None;
+	ev.xconfigure.override_redirect = False;
+	XSendEvent(display, mw->actualWindow, False, StructureNotifyMask, &ev);
+}
+
+/*
+ * Answers a client's ConfigureRequest in terms of its frame, which goes
+ * where the client asked to be (NorthWest gravity), and grows by what it
+ * asked to grow. The border stays as the client was claimed with.
+ */
+static void configureManagedWindow(Display *display, ManagedWindow *mw, const XConfigureRequestEvent *request, ManagedWindowPool *pool) {
+	const unsigned long mask = request->value_mask;
+	const unsigned int old_w = mw->client_w;
+	const unsigned int old_h = mw->client_h;
+
+	if (mask & (CWX | CWY)) {
+		moveWindow(pool, mw, (mask & CWX) ? request->x : mw->x, (mask & CWY) ? request->y : mw->y);
+	}
+
+	/* A collapsed window has no client area to give, it keeps its size for uncollapsing */
+	if ((mask & (CWWidth | CWHeight)) && !mw->collapsed) {
+		const int w = (mask & CWWidth) ? request->width : (int)mw->client_w;
+		const int h = (mask & CWHeight) ? request->height : (int)mw->client_h;
+		resizeWindow(pool, mw, w + FRAME_HORIZONTAL_THICKNESS, h + FRAME_VERTICAL_THICKNESS);
+	}
+
+	if (mask & CWStackMode) {
+		ManagedWindow *sibling = (mask & CWSibling) ? managedWindowForWindow(request->above, pool) : NULL;
+		if (!(mask & CWSibling) || sibling) {
+			restackWindowInPool(display, mw, sibling, request->detail, pool);
+		}
+	}
 
-	XGetWindowAttributes(display, mw->decorationWindow, &attr);
+	/* A real resize is answered by the server's own ConfigureNotify */
+	if (mw->client_w == old_w && mw->client_h == old_h) {
+		sendSyntheticConfigure(display, mw);
+	}
+}
 
+static void collapseWindow(Display *display, ManagedWindowPool *pool, ManagedWindow *mw) {
+	animateFrame(display, mw, pool);
 	if (mw->collapsed) {
 		/* collapsed, uncollapse it */
-		XResizeWindow(display, mw->decorationWindow, mw->last_w, mw->last_h);
-		attr.height = mw->last_h;
+		mw->width = mw->last_w;
+		mw->height = mw->last_h;
 		XMapWindow(display, mw->actualWindow);
 
-		/* Redraw Resizer */
-		drawResizeButton(display, mw->resizer, gc, RECT_RESIZE_DRAW);
+		/* Redraw Resizer, and catch the client up with anything it missed while collapsed */
+		markWindowDirty(mw, DirtyResizer | DirtyClientSize, pool);
 		XRaiseWindow(display, mw->resizer);
 
 		mw->collapsed = 0;
 	}
 	else {
 		/* normal, collapse it */
-		mw->last_w = attr.width;
-		mw->last_h = attr.height;
-		XResizeWindow(display, mw->decorationWindow, attr.width, COLLAPSED_THICKNESS);
-		attr.height = COLLAPSED_THICKNESS;
+		mw->last_w = mw->width;
+		mw->last_h = mw->height;
+		mw->height = COLLAPSED_THICKNESS;
 		XUnmapWindow(display, mw->actualWindow);
 
 		mw->collapsed = 1;
 	}
 
-	drawDecorations(display, mw->decorationBuffer, gc, mw->title, attr, 1);
-	focusWindow(display, mw, gc, pool);
+	markWindowDirty(mw, DirtySize | DirtyDecorations, pool);
+	focusWindow(display, mw, pool);
 }
 
-static void maximizeWindow(Display *display, ManagedWindow *mw, GC gc) {
-	XSizeHints attr;
-	XSizeHints container;
-	long supplied_return;
-	long supplied_return_container;
-
-	XGetWMNormalHints(display, mw->actualWindow, &attr, &supplied_return);
-	XGetWMNormalHints(display, mw->decorationWindow, &container, &supplied_return_container);
-
-	int max_w = (supplied_return | PMaxSize && attr.max_width) ? attr.max_width : XDisplayWidth(display, DefaultScreen(display));
-	int max_h = (supplied_return | PMaxSize && attr.max_height) ? attr.max_height : XDisplayHeight(display, DefaultScreen(display));
+static void maximizeWindow(Display *display, ManagedWindowPool *pool, ManagedWindow *mw) {
+	/* resizeWindow() holds this to the cached maximum size, if the client has one */
+	const int max_w = XDisplayWidth(display, DefaultScreen(display));
+	const int max_h = XDisplayHeight(display, DefaultScreen(display));
 
+	animateFrame(display, mw, pool);
 	if (mw->last_h || mw->last_w || mw->last_x || mw->last_y) {
-		XMoveWindow(display, mw->decorationWindow, mw->last_x, mw->last_y);
-		resizeWindow(display, mw, mw->last_w, mw->last_h);
+		moveWindow(pool, mw, mw->last_x, mw->last_y);
+		resizeWindow(pool, mw, mw->last_w, mw->last_h);
 
 		mw->last_h = 0;
 		mw->last_w = 0;
@@ -145,71 +513,82 @@ static void maximizeWindow(Display *display, ManagedWindow *mw, GC gc) {
 		mw->last_y = 0;
 	}
 	else { /* if we aren't at max size, and there is one, go to it */
-		mw->last_h = attr.height + FRAME_VERTICAL_THICKNESS;
-		mw->last_w = attr.width + FRAME_HORIZONTAL_THICKNESS;
-		mw->last_x = container.x;
-		mw->last_y = container.y;
+		mw->last_h = mw->height;
+		mw->last_w = mw->width;
+		mw->last_x = mw->x;
+		mw->last_y = mw->y;
 
-		XMoveWindow(display, mw->decorationWindow, 0, NEW_WINDOW_OFFSET);
-		resizeWindow(display, mw, max_w, max_h - NEW_WINDOW_OFFSET);
+		moveWindow(pool, mw, 0, NEW_WINDOW_OFFSET);
+		resizeWindow(pool, mw, max_w, max_h - NEW_WINDOW_OFFSET);
 	}
-
-	/* Get dimensions */
-	Window w2; /* unused */
-	XWindowAttributes geometry;
-	XGetGeometry(display, mw->actualWindow, &w2,
-				 (int *)&geometry.x, (int *)&geometry.y,
-				 (unsigned int *)&geometry.width, (unsigned int *)&geometry.height,
-				 (unsigned int *)&geometry.border_width, (unsigned int *)&geometry.depth);
-
-
-	DRAW_ACTION(display, mw->decorationWindow, {
-		drawDecorations(display, mw->decorationBuffer, gc, mw->title, geometry, 1);
-	});
 }
 
-static void claimWindow(Display *display, Window window, Window root, GC gc, ManagedWindowPool *pool) {
-	XSizeHints attr;
-	long supplied_return = PPosition | PSize | PMinSize;
+/* Claimed windows start out inactive, callers activate the one that should have focus */
+static ManagedWindow *claimWindow(Display *display, const ClaimInfo *info, Window root, ManagedWindowPool *pool) {
+	Window window = info->window;
 	Window resizer;
 
-	XGetWMNormalHints(display, window, &attr, &supplied_return);
+	/* XIDs do come back, once their owner runs out of fresh ones */
+	exhumeWindow(window);
 
 	/*
-	XMoveWindow(display, window, attr.x, attr.y);
-	XResizeWindow(display, window, attr.width, attr.height);
-
-	warnx("Trying to reparent %d at {%d, %d, %d, %d} with flags %d\n", window, attr.x, attr.y, attr.width, attr.height, attr.flags);
+	warnx("Trying to reparent %d at {%d, %d, %d, %d} with flags %d\n", window, info->x, info->y, info->width, info->height, info->hints.flags);
 	*/
 
-	Window deco = decorateWindow(display, window, root, gc, attr.x, attr.y, attr.width, attr.height, &resizer);
+	Window deco = decorateWindow(display, window, root, info->x, info->y, info->width, info->height, info->border_width, &resizer);
 
 	/*
-	XMoveWindow(display, deco, XDisplayWidth(display, DefaultScreen(display)) - attr.width - 3, NEW_WINDOW_OFFSET);
+	XMoveWindow(display, deco, XDisplayWidth(display, DefaultScreen(display)) - info->width - 3, NEW_WINDOW_OFFSET);
 	*/
 
 	/* Start listening for events on the window */
 	/* FIXME: is this where focus events should be listened to? */
-	XSelectInput(display, window, SubstructureNotifyMask | ExposureMask);
-	XSelectInput(display, deco, ExposureMask);
+	XSelectInput(display, window, StructureNotifyMask | SubstructureNotifyMask | ExposureMask | PropertyChangeMask);
+	/* The client's own map and configure requests come to us, see configureManagedWindow() */
+	XSelectInput(display, deco, ExposureMask | SubstructureRedirectMask);
 	XSelectInput(display, resizer, ExposureMask);
 
-	pool->active = addWindowToPool(display, deco, window, resizer, pool);
-	focusWindow(display, pool->active, gc, pool);
-
-	if (supplied_return & PMinSize) {
-		pool->active->min_w = attr.min_width;
-		pool->active->min_h = attr.min_height;
-	}
+	exhumeWindow(deco);
+	exhumeWindow(resizer);
+	ManagedWindow *mw = addWindowToPool(display, deco, window, resizer, info->title, pool);
+	traceClaim(info, deco, resizer);
+	addSubwindowsToPool(mw, info->children, info->nchildren, pool);
+	mw->x = info->x;
+	mw->y = info->y;
+	mw->width = info->width + FRAME_HORIZONTAL_THICKNESS;
+	mw->height = info->height + FRAME_VERTICAL_THICKNESS;
+	mw->client_w = info->width;
+	mw->client_h = info->height;
+	mw->border_width = info->border_width;
+	setButtonGrab(display, mw, 1);
+	watchSyncCounter(display, mw, info->syncCounter, pool);
+
+	/* The frame's first paint, inactive until something focuses it, goes out with the next frame */
+	markWindowDirty(mw, DirtyDecorations | DirtyResizer, pool);
+
+	/* From here on, only PropertyNotify updates these */
+	setWindowHints(mw, &info->hints, info->supplied_hints);
+	mw->protocols = info->protocols;
+	return mw;
 }
 
-static void unclaimWindow(Display *display, Window window, ManagedWindowPool *pool) {
-	ManagedWindow *mw = managedWindowForWindow(display, window, pool);
+/* Requests from diedAt on may find the client gone, see tombstone.h */
+static void unclaimWindow(Display *display, Window window, unsigned long diedAt, ManagedWindowPool *pool) {
+	ManagedWindow *mw = managedWindowForWindow(window, pool);
 	if (mw) {
+		buryWindow(mw->actualWindow, diedAt);
+		buryWindow(mw->decorationWindow, NextRequest(display));
+		buryWindow(mw->resizer, NextRequest(display));
+
+		/* Xdbe buffers die with their window, and freeing one after that is an error */
+		releaseBackBuffer(display, mw);
+		releaseFrameBackground(display, mw);
 		undecorateWindow(display, mw->decorationWindow, mw->resizer);
-		decorationWindowDestroyed = mw->decorationWindow;
-		resizerDestroyed = mw->resizer;
+		unwatchSyncCounter(display, mw, pool);
 		removeWindowFromPool(display, mw, pool);
+#ifdef DEBUG
+		printResourceCounts(stderr);
+#endif
 	}
 }
 
@@ -233,7 +612,29 @@ static void redrawButtonState(int *stateToken, decorationFunction buttonFunction
 	}
 }
 
-static void claimAllWindows(Display *display, Window root, ManagedWindowPool *pool) {
+static int redirectFailed;
+
+static int catchRedirectError(Display *display, XErrorEvent *error) {
+	(void)display;
+	(void)error;
+	redirectFailed = 1;
+	return 0;
+}
+
+/* Only one client may redirect the root's children, so this returns 0 if some other window manager does */
+static int redirectRoot(Display *display, Window root) {
+	int (*previous)(Display *, XErrorEvent *);
+
+	redirectFailed = 0;
+	previous = XSetErrorHandler(catchRedirectError);
+	XSelectInput(display, root, StructureNotifyMask | SubstructureNotifyMask /* CreateNotify */ | SubstructureRedirectMask | ButtonPressMask);
+	XSync(display, False);
+	XSetErrorHandler(previous);
+
+	return !redirectFailed;
+}
+
+static void claimAllWindows(Display *display, Window root, GC gc, ManagedWindowPool *pool) {
 	/* This should only be called once, and only on startup */
 	static int once;
 	assert(!once++);
@@ -242,306 +643,753 @@ static void claimAllWindows(Display *display, Window root, ManagedWindowPool *po
 	Window *children;
 	unsigned int nchildren;
 
-	XQueryTree(display, root, &root, &parent, &children, &nchildren);
+	/* Adopt everything as one atomic pass, nothing can change underneath us */
+	XGrabServer(display);
 
-	unsigned int i;
-	for (i = 0; i < nchildren; i++) {
-		if (children[i] && children[i] != root) {
-			GC gc = XCreateGC(display, children[i], 0, 0);
-			claimWindow(display, children[i], root, gc, pool);
-			XFlush(display);
-			XFreeGC(display, gc);
+	if (XQueryTree(display, root, &root, &parent, &children, &nchildren) && nchildren) {
+		ClaimInfo *infos = calloc(nchildren, sizeof(ClaimInfo));
+		assert(infos);
+
+		/* Unmapped and InputOnly windows are skipped, they get claimed on MapRequest */
+		unsigned int claimable = fetchAllClaimInfo(display, children, nchildren, infos);
+
+		ManagedWindow *last = NULL;
+		unsigned int i;
+		for (i = 0; i < claimable; i++) {
+			last = claimWindow(display, &infos[i], root, pool);
+			freeClaimInfo(&infos[i]);
 		}
-		else {
-			warnx("Could not find window with XID:%ld\n", children[i]);
+
+		/* The topmost window gets focus, once, instead of every window in turn */
+		if (last) {
+			activateWindow(display, last, pool);
 		}
+
+		free(infos);
+		XFree(children);
 	}
 
-	XFree(children);
+	XUngrabServer(display);
+	XFlush(display);
 }
 
-int main (int argc, const char * argv[]) {
-	(void)argc;
-	(void)argv;
+static void usage(void) {
+	fprintf(stderr, "usage: classic-wm [-opu] [-b none|backing|saveunder|both] [-r framerate] [-s statsfile [-i interval]] [-t tracefile | -R tracefile]\n");
+	exit(EX_USAGE);
+}
 
-	Display *display;
-	XEvent ev;
-	int screen;
-	XWindowAttributes attr;
-	XButtonEvent start = {0};
-	MouseDownState downState = MouseDownStateUnknown;
-	time_t lastClickTime = 0;
-	Window lastClickWindow = 0;
+/* Returns the FrameStorePolicy for a -b argument, or -1 */
+static int parseFrameStorePolicy(const char *name) {
+	static const struct {
+		const char *name;
+		int policy;
+	} policies[] = {
+		{"none", FrameStoreNone},
+		{"backing", FrameStoreBacking},
+		{"saveunder", FrameStoreSaveUnder},
+		{"both", FrameStoreBacking | FrameStoreSaveUnder},
+	};
+	unsigned int i;
 
-	ManagedWindowPool *pool = createPool();
+	for (i = 0; i < sizeof(policies) / sizeof(policies[0]); i++) {
+		if (!strcmp(name, policies[i].name)) {
+			return policies[i].policy;
+		}
+	}
+	return -1;
+}
 
-	/* Set up */
-	display = XOpenDisplay(getenv("DISPLAY"));
-	if (!display) {
-		errx(EX_UNAVAILABLE, "Failed to open display, is X running?\n");
+/* Drag and click state, carried from one event to the next */
+static XWindowAttributes attr;
+static XButtonEvent start;
+static MouseDownState downState = MouseDownStateUnknown;
+static time_t lastClickTime;
+static Window lastClickWindow;
+
+/* The next motion for this window that has already arrived, taken from the trace when replaying one */
+static int nextQueuedMotion(Display *display, Window window, XEvent *ev) {
+	if (replaying) {
+		return readCoalescedEvent(display, ev);
 	}
 
-	screen = DefaultScreen(display);
+	if (XPending(display) && XCheckTypedWindowEvent(display, window, MotionNotify, ev)) {
+		traceEvent(display, ev, 1);
+		return 1;
+	}
+	return 0;
+}
 
-	/* Find the window */
-	Window root = RootWindow(display, screen);
+/* Handles one event, which at most marks windows dirty for the next frame */
+static void handleEvent(Display *display, XEvent ev, Window root, GC gc, GC outlineGC, ManagedWindowPool *pool) {
+	/*
+	warnx("Got event \"%s\"\n", event_names[ev.type]);
+	*/
+	/* Whatever was still on its way for a window we've let go of */
+	if (windowIsBuried(ev.xany.window)) {
+		return;
+	}
 
-	/* Initial capture of all windows on startup */
-	claimAllWindows(display, root, pool);
+	/* Extension events have no fixed type, so they can't be cases below */
+	if (handleSyncEvent(&ev, pool) || handleFrameImageEvent(&ev)) {
+		return;
+	}
 
-	XSelectInput(display, root, StructureNotifyMask | SubstructureNotifyMask /* CreateNotify */ | ButtonPressMask);
+	/* This is a collection of everything that should short-circuit */
+	switch(ev.type) {
+		case DestroyNotify:
+			/*
+			 * NOTE: The XDestroyWindowEvent structure is tricky.
+			 * xdestroywindow.window is the window that was destroyed,
+			 * while xdestroywindow.event (which ev.xany.window lines up
+			 * with) is the window it was reported to. Clients select
+			 * SubstructureNotify too, so the death of one of their own
+			 * subwindows is reported to the client, which is still alive.
+			 */
+			forgetSubwindowInPool(ev.xdestroywindow.window, pool);
+			if (ev.xdestroywindow.window == ev.xdestroywindow.event) {
+				unclaimWindow(display, ev.xdestroywindow.window, ev.xdestroywindow.serial, pool);
+			}
+			return;
+		case CreateNotify:
+			reparentSubwindowInPool(ev.xcreatewindow.window, ev.xcreatewindow.parent, pool);
+			return;
+		case ReparentNotify:
+			reparentSubwindowInPool(ev.xreparent.window, ev.xreparent.parent, pool);
+			return;
+		case ConfigureNotify: {
+			ManagedWindow *mw = managedWindowForWindow(ev.xconfigure.window, pool);
+			if (mw) {
+				updateWindowGeometry(mw, &ev.xconfigure);
+				stackWindowInPool(mw, &ev.xconfigure, pool);
+			}
+		} return;
+		case PropertyNotify: {
+			ManagedWindow *mw = managedWindowForWindow(ev.xproperty.window, pool);
+			if (mw && ev.xproperty.window == mw->actualWindow) {
+				refreshProperty(display, mw, ev.xproperty.atom, pool);
+			}
+		} return;
+		case UnmapNotify:
+			/*
+			 * These are intentionally unhandled notifications that are
+			 * caught in the structure notification masks. So, don't
+			 * let the default case log them.
+			 */
+			return;
+
+		case ButtonPress: {
+			if (ev.xkey.subwindow == None) {
+				return;
+			}
+		} break;
+		case Expose: {
+			if(downState == MouseDownStateResize) {
+				return;
+			}
+		} break;
+		case MapNotify: {
+			if (managedWindowForWindow(ev.xmap.window, pool) || ev.xmap.override_redirect) {
+				return;
+			}
+		} break;
+	}
 
-	while(XNextEvent(display, &ev) == 0) {
-		/*
-		warnx("Got event \"%s\"\n", event_names[ev.type]);
-		*/
-		if (ev.xany.window == decorationWindowDestroyed || ev.xany.window == resizerDestroyed) {
-			continue;
-		}
-
-		/* This is a collection of everything that should short-circuit */
-		switch(ev.type) {
-			case DestroyNotify:
-				/*
-				 * NOTE: The XDestroyWindowEvent structure is tricky.
-				 * ev.xany.window lines up with ev.xdestroywindow.event,
-				 * because xdestroywindow.event is the window being
-				 * destroyed, while xdestroywindow.window is used for some
-				 * other toolkit nonsense.
-				 */
-				unclaimWindow(display, ev.xdestroywindow.event, pool);
-			case UnmapNotify:
-			case ReparentNotify:
-			case CreateNotify:
-			case ConfigureNotify:
-			case PropertyNotify:
-				/*
-				 * These are intentionally unhandled notifications that are
-				 * caught in the structure notification masks. So, don't
-				 * let the default case log them.
-				 */
-				continue;
-
-			case ButtonPress: {
-				if (ev.xkey.subwindow == None) {
-					continue;
-				}
-			} break;
-			case Expose: {
-				if(downState == MouseDownStateResize) {
-					continue;
+	switch (ev.type) {
+		case ButtonPress: {
+			ManagedWindow *mw = managedWindowForWindow(ev.xkey.subwindow, pool);
+			if (!mw) {
+				break;
+			}
+
+			/* Raise and activate the window, redrawing it now if the focus changed */
+			focusWindow(display, mw, pool);
+			if (mw->dirty) {
+				flushWindow(display, gc, mw, pool, NULL);
+			}
+			attr = frameAttributes(mw);
+
+			/*
+			 * These x,y assignments cannot be consolidated with the other
+			 * ones, since these don't recycle the previous attr, but the
+			 * other ones do.
+			 */
+			const int x = ev.xbutton.x_root - attr.x;
+			const int y = ev.xbutton.y_root - attr.y;
+
+			/* Check what was downed */
+			downState = MouseDownStateUnknown;
+			if (pointIsInRect(x, y, RECT_TITLEBAR)) {
+				downState = MouseDownStateMove;
+				/* Grab the pointer */
+				XGrabPointer(display, ev.xbutton.subwindow, True,
+							 PointerMotionMask|ButtonReleaseMask, GrabModeAsync,
+							 GrabModeAsync, None, None, CurrentTime);
+				start = ev.xbutton;
+				beginDragLatency(ev.xbutton.time);
+				beginDragStats();
+				setFrameSaveUnder(display, mw->decorationWindow, 1);
+			}
+			if (pointIsInRect(x, y, RECT_CLOSE_BTN)) {
+				drawCloseButtonDown(display, mw->decorationWindow, gc, RECT_CLOSE_BTN);
+				downState = MouseDownStateClose;
+			}
+			if (pointIsInRect(x, y, RECT_MAX_BTN)) {
+				drawCloseButtonDown(display, mw->decorationWindow, gc, RECT_MAX_BTN);
+				downState = MouseDownStateMaximize;
+				lastClickTime = 0;
+			}
+	#if COLLAPSE_BUTTON_ENABLED
+			if (pointIsInRect(x, y, RECT_COLLAPSE_BTN)) {
+				drawCloseButtonDown(display, mw->decorationWindow, gc, RECT_COLLAPSE_BTN);
+				downState = MouseDownStateCollapse;
+				lastClickTime = 0;
+			}
+	#endif
+			if (!mw->collapsed &&
+				(ev.xbutton.subwindow == mw->resizer || pointIsInRect(x, y, RECT_RESIZE_BTN))) {
+				/* Grab the pointer */
+				XGrabPointer(display, ev.xbutton.subwindow, True,
+							 PointerMotionMask|ButtonReleaseMask, GrabModeAsync,
+							 GrabModeAsync, None, None, CurrentTime);
+				start = ev.xbutton;
+				beginDragLatency(ev.xbutton.time);
+				beginDragStats();
+				lastClickTime = 0;
+				downState = MouseDownStateResize;
+			}
+
+			/*
+			 * Nothing else may draw while the rubber band is up, or it
+			 * would leave XOR droppings behind when it moves.
+			 */
+			if (outlineMode && (downState == MouseDownStateMove || downState == MouseDownStateResize)) {
+				XGrabServer(display);
+				showOutline(display, root, outlineGC, attr.x, attr.y, attr.width, attr.height);
+			}
+		} break;
+		case Expose: {
+			ManagedWindow *mw = managedWindowForWindow(ev.xexpose.window, pool);
+			if (!mw) {
+				break;
+			}
+
+			if (ev.xexpose.window == mw->decorationWindow) {
+				countStat(StatExposeReceived);
+			}
+
+			/* Already repainted by the server, from the backgrounds, see -p */
+			if (mw->background) {
+				break;
+			}
+
+			if (ev.xexpose.window == mw->resizer) {
+				/* The resizer is tiny, just redraw it once the series is done */
+				if (ev.xexpose.count == 0) {
+					markWindowDirty(mw, DirtyResizer, pool);
 				}
-			} break;
-			case MapNotify: {
-				if (managedWindowForWindow(display, ev.xmap.window, pool) || ev.xmap.override_redirect) {
-					continue;
+			}
+			else if (ev.xexpose.window == mw->decorationWindow) {
+				/* Collect the damage until the last Expose in this series */
+				XRectangle rect;
+				rect.x = ev.xexpose.x;
+				rect.y = ev.xexpose.y;
+				rect.width = ev.xexpose.width;
+				rect.height = ev.xexpose.height;
+
+				if (!mw->damage) {
+					mw->damage = XCreateRegion();
 				}
-			} break;
-		}
-
-		GC gc = XCreateGC(display, ev.xany.window, 0, 0);
-		switch (ev.type) {
-			case ButtonPress: {
-				ManagedWindow *mw = managedWindowForWindow(display, ev.xkey.subwindow, pool);
-				if (!mw) {
-					break;
+				else {
+					/* Joins damage that is already waiting, so it costs no paint of its own */
+					countStat(StatExposeCoalesced);
 				}
+				XUnionRectWithRegion(&rect, mw->damage, mw->damage);
 
-				/* Raise and activate the window, while lowering all others */
-				focusWindow(display, mw, gc, pool);
-
-				/* Redraw the decorations, just in case the focus changed */
-				XGetWindowAttributes(display, mw->decorationWindow, &attr);
-				drawDecorations(display, mw->decorationWindow, gc, mw->title, attr, 1);
-
-				/*
-				 * These x,y assignments cannot be consolidated with the other
-				 * ones, since these don't recycle the previous attr, but the
-				 * other ones do.
-				 */
-				const int x = ev.xbutton.x_root - attr.x;
-				const int y = ev.xbutton.y_root - attr.y;
-
-				/* Check what was downed */
-				downState = MouseDownStateUnknown;
-				if (pointIsInRect(x, y, RECT_TITLEBAR)) {
-					downState = MouseDownStateMove;
-					/* Grab the pointer */
-					XGrabPointer(display, ev.xbutton.subwindow, True,
-								 PointerMotionMask|ButtonReleaseMask, GrabModeAsync,
-								 GrabModeAsync, None, None, CurrentTime);
-					start = ev.xbutton;
-				}
-				if (pointIsInRect(x, y, RECT_CLOSE_BTN)) {
-					drawCloseButtonDown(display, mw->decorationWindow, gc, RECT_CLOSE_BTN);
-					downState = MouseDownStateClose;
-				}
-				if (pointIsInRect(x, y, RECT_MAX_BTN)) {
-					drawCloseButtonDown(display, mw->decorationWindow, gc, RECT_MAX_BTN);
-					downState = MouseDownStateMaximize;
-					lastClickTime = 0;
-				}
-#if COLLAPSE_BUTTON_ENABLED
-				if (pointIsInRect(x, y, RECT_COLLAPSE_BTN)) {
-					drawCloseButtonDown(display, mw->decorationWindow, gc, RECT_COLLAPSE_BTN);
-					downState = MouseDownStateCollapse;
-					lastClickTime = 0;
+				if (ev.xexpose.count == 0) {
+					markWindowDirty(mw, DirtyDamage, pool);
 				}
+			}
+		} break;
+		case MotionNotify: {
+			/* Invalidate double clicks */
+			lastClickTime = 0;
+
+			/*
+			 * If we have a bunch of MotionNotify events queued up for
+			 * this window, drop all but the last one, since all math is
+			 * relative. XPending reads whatever else has arrived without
+			 * blocking, so nothing here waits on the server.
+			 */
+			while (nextQueuedMotion(display, ev.xmotion.window, &ev));
+
+			const int x = ev.xbutton.x_root - attr.x;
+			const int y = ev.xbutton.y_root - attr.y;
+
+			const int dx = ev.xbutton.x_root - start.x_root;
+			const int dy = ev.xbutton.y_root - start.y_root;
+
+			switch (downState) {
+				case MouseDownStateResize: {
+					ManagedWindow *mw = managedWindowForWindow(start.subwindow, pool);
+
+					if (outlineMode) {
+						int w = attr.width + dx;
+						int h = attr.height + dy;
+						constrainFrameSize(mw, &w, &h);
+						showOutline(display, root, outlineGC, attr.x, attr.y, w, h);
+					}
+					else {
+						/* Resize, and redraw the titlebar and resizer at the next frame */
+						animateFrame(display, mw, pool);
+						resizeWindow(pool, mw, attr.width + dx, attr.height + dy);
+						dragLatency.pending = ev.xmotion.time / 1000.0;
+					}
+					start.x_root = ev.xbutton.x_root;
+					start.y_root = ev.xbutton.y_root;
+
+					/* Persist that info for next iteration */
+					attr.width += dx;
+					attr.height += dy;
+				} break;
+				case MouseDownStateMove: {
+					ManagedWindow *mw = managedWindowForWindow(ev.xmotion.window, pool);
+					if (outlineMode) {
+						showOutline(display, root, outlineGC, attr.x + dx, attr.y + dy, attr.width, attr.height);
+					}
+					else if (mw) {
+						moveWindow(pool, mw, attr.x + dx, attr.y + dy);
+						dragLatency.pending = ev.xmotion.time / 1000.0;
+					}
+				} break;
+				case MouseDownStateClose: {
+					static int closeButtonStateToken;
+					redrawButtonState(&closeButtonStateToken, drawCloseButton, display, ev.xmotion.window, gc, x, y, RECT_CLOSE_BTN);
+				} break;
+				case MouseDownStateMaximize: {
+					static int maximizeButtonStateToken;
+					redrawButtonState(&maximizeButtonStateToken, drawMaximizeButton, display, ev.xmotion.window, gc, x, y, RECT_MAX_BTN);
+				} break;
+	#if COLLAPSE_BUTTON_ENABLED
+				case MouseDownStateCollapse: {
+					static int collapseButtonStateToken;
+					redrawButtonState(&collapseButtonStateToken, drawCollapseButton, display, ev.xmotion.window, gc, x, y, RECT_COLLAPSE_BTN);
+				} break;
+	#endif
+				default:
+					break;
+			}
+		} break;
+		case ButtonRelease: {
+			XUngrabPointer(display, CurrentTime);
+#ifdef DEBUG
+			if (dragLatency.samples) {
+				warnx("Drag latency: %lu frames, mean %.2fms, worst %.2fms",
+					  dragLatency.samples,
+					  dragLatency.total * 1000.0 / dragLatency.samples,
+					  dragLatency.worst * 1000.0);
+			}
 #endif
-				if (!mw->collapsed &&
-					(ev.xbutton.subwindow == mw->resizer || pointIsInRect(x, y, RECT_RESIZE_BTN))) {
-					/* Grab the pointer */
-					XGrabPointer(display, ev.xbutton.subwindow, True,
-								 PointerMotionMask|ButtonReleaseMask, GrabModeAsync,
-								 GrabModeAsync, None, None, CurrentTime);
-					start = ev.xbutton;
-					lastClickTime = 0;
-					downState = MouseDownStateResize;
+			dragLatency.samples = 0;
+			endDragStats();
+			if (downState == MouseDownStateMove) {
+				ManagedWindow *mw = managedWindowForWindow(start.subwindow, pool);
+				if (mw) {
+					setFrameSaveUnder(display, mw->decorationWindow, 0);
 				}
-			} break;
-			case Expose: {
-				ManagedWindow *mw = managedWindowForWindow(display, ev.xexpose.window, pool);
+			}
 
+			/* An outline drag configures the frame and client exactly once, now */
+			if (outline.shown) {
+				hideOutline(display, root, outlineGC);
+				XUngrabServer(display);
+
+				ManagedWindow *mw = managedWindowForWindow(start.subwindow, pool);
 				if (mw) {
-					/* TODO: This probably performs terribly, replace me with some caching */
-					XWindowAttributes geometry;
-					Window w2; /* unused */
-					XGetGeometry(display, mw->decorationWindow, &w2,
-								 (int *)&geometry.x, (int *)&geometry.y,
-								 (unsigned int *)&geometry.width, (unsigned int *)&geometry.height,
-								 (unsigned int *)&geometry.border_width, (unsigned int *)&geometry.depth);
-
-					/* Redraw titlebar based on active or not */
-					DRAW_ACTION(display, mw->decorationWindow, {
-						drawDecorations(display, mw->decorationBuffer, gc, mw->title, geometry, (mw == pool->active));
-					});
-
-					/* Redraw Resizer */
-					drawResizeButton(display, mw->resizer, gc, RECT_RESIZE_DRAW);
+					if (downState == MouseDownStateResize) {
+						resizeWindow(pool, mw, outline.width, outline.height);
+					}
+					else {
+						moveWindow(pool, mw, outline.x, outline.y);
+					}
 				}
-			} break;
-			case MotionNotify: {
-				/* Invalidate double clicks */
-				lastClickTime = 0;
-
-				/* If we have a bunch of MotionNotify events queued up, */
-				/* drop all but the last one, since all math is relative */
-				while(XCheckTypedEvent(display, MotionNotify, &ev));
-
-				const int x = ev.xbutton.x_root - attr.x;
-				const int y = ev.xbutton.y_root - attr.y;
-
-				const int dx = ev.xbutton.x_root - start.x_root;
-				const int dy = ev.xbutton.y_root - start.y_root;
-
-				switch (downState) {
-					case MouseDownStateResize: {
-						ManagedWindow *mw = managedWindowForWindow(display, start.subwindow, pool);
-
-						/* Resize */
-						resizeWindow(display, mw, attr.width + dx, attr.height + dy);
-						start.x_root = ev.xbutton.x_root;
-						start.y_root = ev.xbutton.y_root;
-
-						/* Persist that info for next iteration */
-						attr.width += dx;
-						attr.height += dy;
-
-						/* Redraw Titlebar */
-						DRAW_ACTION(display, mw->decorationWindow, {
-							drawDecorations(display, mw->decorationBuffer, gc, mw->title, attr, 1);
-						});
-
-						/* Redraw Resizer */
-						drawResizeButton(display, mw->resizer, gc, RECT_RESIZE_DRAW);
-					} break;
-					case MouseDownStateMove: {
-						XMoveWindow(display, ev.xmotion.window, attr.x + dx, attr.y + dy);
-					} break;
-					case MouseDownStateClose: {
-						static int closeButtonStateToken;
-						redrawButtonState(&closeButtonStateToken, drawCloseButton, display, ev.xmotion.window, gc, x, y, RECT_CLOSE_BTN);
-					} break;
-					case MouseDownStateMaximize: {
-						static int maximizeButtonStateToken;
-						redrawButtonState(&maximizeButtonStateToken, drawMaximizeButton, display, ev.xmotion.window, gc, x, y, RECT_MAX_BTN);
-					} break;
-#if COLLAPSE_BUTTON_ENABLED
-					case MouseDownStateCollapse: {
-						static int collapseButtonStateToken;
-						redrawButtonState(&collapseButtonStateToken, drawCollapseButton, display, ev.xmotion.window, gc, x, y, RECT_COLLAPSE_BTN);
-					} break;
-#endif
-					default:
-						break;
+			}
+
+			const int x = ev.xbutton.x_root - attr.x;
+			const int y = ev.xbutton.y_root - attr.y;
+
+			switch (downState) {
+				case MouseDownStateClose: {
+					drawCloseButton(display, ev.xmotion.window, gc, RECT_CLOSE_BTN);
+
+					if (pointIsInRect(x, y, RECT_CLOSE_BTN)) {
+						unclaimWindow(display, ev.xmotion.window, NextRequest(display), pool);
+					}
+				} break;
+	#if COLLAPSE_BUTTON_ENABLED
+				case MouseDownStateCollapse: {
+					drawCollapseButton(display, ev.xmotion.window, gc, RECT_COLLAPSE_BTN);
+
+					if (pointIsInRect(x, y, RECT_COLLAPSE_BTN)) {
+						ManagedWindow *mw = managedWindowForWindow(ev.xmotion.window, pool);
+						collapseWindow(display, pool, mw);
+						lastClickTime = 0;
+					}
+				} break;
+	#endif
+				case MouseDownStateMaximize: {
+					drawMaximizeButton(display, ev.xmotion.window, gc, RECT_MAX_BTN);
+
+					if (pointIsInRect(x, y, RECT_MAX_BTN)) {
+						ManagedWindow *mw = managedWindowForWindow(ev.xmotion.window, pool);
+						maximizeWindow(display, pool, mw);
+					}
+				} break;
+				default: { /* Anywhere else on the titlebar */
+					if (ev.xkey.window != None) {
+						ManagedWindow *mw = managedWindowForWindow(ev.xkey.window, pool);
+
+						if (lastClickTime >= (time(NULL) - 1) && lastClickWindow == mw->decorationWindow) {
+							collapseWindow(display, pool, mw);
+							lastClickTime = 0;
+						}
+						else {
+							lastClickWindow = mw->decorationWindow;
+							time(&lastClickTime);
+						}
+					}
+				} break;
+			}
+		} break;
+		case MapRequest: {
+			ManagedWindow *mw = managedWindowForWindow(ev.xmaprequest.window, pool);
+			ClaimInfo info;
+
+			/* A client remapping itself inside its frame only needs the map, unless it's collapsed */
+			if (mw && mw->actualWindow == ev.xmaprequest.window) {
+				if (!mw->collapsed) {
+					XMapWindow(display, ev.xmaprequest.window);
 				}
+				break;
+			}
+
+			/* Framed before it is ever mapped, so the client is never seen undecorated */
+			if (fetchClaimInfo(display, ev.xmaprequest.window, &info)) {
+				activateWindow(display, claimWindow(display, &info, root, pool), pool);
+				freeClaimInfo(&info);
+			}
+		} break;
+		case ConfigureRequest: {
+			const XConfigureRequestEvent *request = &ev.xconfigurerequest;
+			ManagedWindow *mw = managedWindowForWindow(request->window, pool);
+
+			if (mw && mw->actualWindow == request->window) {
+				configureManagedWindow(display, mw, request, pool);
+			}
+			else {
+				/* Not framed (yet), so it gets exactly what it asked for */
+				XWindowChanges changes;
+				changes.x = request->x;
+				changes.y = request->y;
+				changes.width = request->width;
+				changes.height = request->height;
+				changes.border_width = request->border_width;
+				changes.sibling = request->above;
+				changes.stack_mode = request->detail;
+				XConfigureWindow(display, request->window, request->value_mask, &changes);
+			}
+		} break;
+		case MapNotify: {
+			if (!ev.xmap.window) {
+				warnx("Recieved invalid window for event \"%s\"\n", event_names[ev.type]);
+			}
+			ClaimInfo info;
+			if (fetchClaimInfo(display, ev.xmap.window, &info)) {
+				activateWindow(display, claimWindow(display, &info, root, pool), pool);
+				freeClaimInfo(&info);
+			}
+		} break;
+		default: {
+			warnx("Recieved unhandled event \"%s\"\n", event_names[ev.type]);
+		} break;
+	}
+}
 
-				/* Syncing is required to properly consolidate MotionEvents */
-				XSync(display, False);
-			} break;
-			case ButtonRelease: {
-				XUngrabPointer(display, CurrentTime);
+/* The earliest a window still on the dirty list may send its client a resize */
+static double nextClientResizeDue(ManagedWindowPool *pool) {
+	ManagedWindow *mw;
+	double due = -1;
 
-				const int x = ev.xbutton.x_root - attr.x;
-				const int y = ev.xbutton.y_root - attr.y;
+	SLIST_FOREACH(mw, &pool->dirty, dirtyEntries) {
+		if (due < 0 || mw->clientResizeDue < due) {
+			due = mw->clientResizeDue;
+		}
+	}
+	return due;
+}
 
-				switch (downState) {
-					case MouseDownStateClose: {
-						drawCloseButton(display, ev.xmotion.window, gc, RECT_CLOSE_BTN);
+static void eventLoop(Display *display, Window root, GC gc, GC outlineGC, ManagedWindowPool *pool, double frameInterval) {
+	XEvent ev;
+	double nextFrame = 0;
+
+	for (;;) {
+		/* Drain everything that has already arrived, which only marks windows dirty */
+		while (XPending(display)) {
+			XNextEvent(display, &ev);
+			traceEvent(display, &ev, 0);
+			beginEventStats(display, ev.type);
+			handleEvent(display, ev, root, gc, outlineGC, pool);
+			endEventStats(display);
+		}
 
-						if (pointIsInRect(x, y, RECT_CLOSE_BTN)) {
-							unclaimWindow(display, ev.xmotion.window, pool);
-						}
-					} break;
-#if COLLAPSE_BUTTON_ENABLED
-					case MouseDownStateCollapse: {
-						drawCollapseButton(display, ev.xmotion.window, gc, RECT_COLLAPSE_BTN);
+		/* Then configure and repaint each dirty window at most once per frame */
+		double timeout = -1;
+		if (!SLIST_EMPTY(&pool->dirty)) {
+			const double now = currentTime();
+			if (now >= nextFrame) {
+				flushFrame(display, root, gc, outlineGC, pool);
+				nextFrame = now + frameInterval;
+			}
+			else {
+				timeout = nextFrame - now;
+			}
+		}
 
-						if (pointIsInRect(x, y, RECT_COLLAPSE_BTN)) {
-							ManagedWindow *mw = managedWindowForWindow(ev.xmotion.window, pool);
-							collapseWindow(display, pool, mw, gc);
-							lastClickTime = 0;
-						}
-					} break;
-#endif
-					case MouseDownStateMaximize: {
-						drawMaximizeButton(display, ev.xmotion.window, gc, RECT_MAX_BTN);
+		/* Held back client resizes wake the loop when they are due, not on the next event */
+		if (timeout < 0 && !SLIST_EMPTY(&pool->dirty)) {
+			const double due = nextClientResizeDue(pool);
 
-						if (pointIsInRect(x, y, RECT_MAX_BTN)) {
-							ManagedWindow *mw = managedWindowForWindow(display, ev.xmotion.window, pool);
-							maximizeWindow(display, mw, gc);
-						}
-					} break;
-					default: { /* Anywhere else on the titlebar */
-						if (ev.xkey.window != None) {
-							ManagedWindow *mw = managedWindowForWindow(display, ev.xkey.window, pool);
-
-							if (lastClickTime >= (time(NULL) - 1) && lastClickWindow == mw->decorationWindow) {
-								collapseWindow(display, pool, mw, gc);
-								lastClickTime = 0;
-							}
-							else {
-								lastClickWindow = mw->decorationWindow;
-								time(&lastClickTime);
-							}
-						}
-					} break;
+			timeout = (due > nextFrame ? due : nextFrame) - currentTime();
+			if (timeout < 0) {
+				timeout = 0;
+			}
+		}
+
+		/* Back buffers nothing has drawn into for a while go back to the server */
+		{
+			const double idleWait = releaseIdleBackBuffers(display, pool, currentTime());
+			if (idleWait >= 0 && (timeout < 0 || idleWait < timeout)) {
+				timeout = idleWait;
+			}
+		}
+
+		/* SIGUSR1 interrupts the wait below, and gets its dump here the next time around */
+		if (statsEnabled()) {
+			const double now = currentTime();
+			double statsWait;
+
+			dumpStatsIfDue(pool, now);
+			statsWait = statsTimeout(now);
+			if (statsWait >= 0 && (timeout < 0 || statsWait < timeout)) {
+				timeout = statsWait;
+			}
+		}
+
+		/* Whatever is buffered survives being killed while idle */
+		flushTrace();
+		XFlush(display);
+		if (waitForDisplay(display, timeout) < 0) {
+			break;
+		}
+	}
+}
+
+static int countReplayError(Display *display, XErrorEvent *error) {
+	/* Surrogates only go so far in standing in for the real clients, so some requests miss */
+	(void)display;
+	(void)error;
+	replayErrors++;
+	return 0;
+}
+
+static void replayClaim(Display *display, const TraceRecord *record, Window root, GC gc, ManagedWindowPool *pool) {
+	ManagedWindow *mw = managedWindowForWindow(replayedWindow(record->window), pool);
+
+	/* Windows adopted at startup never had a MapNotify to claim them */
+	if (!mw) {
+		ClaimInfo info;
+		Window window = createSurrogateWindow(display, record);
+		if (fetchClaimInfo(display, window, &info)) {
+			activateWindow(display, claimWindow(display, &info, root, pool), pool);
+			freeClaimInfo(&info);
+		}
+		mw = managedWindowForWindow(window, pool);
+	}
+
+	/* Later events name the recorded frame, which is this one now */
+	if (mw) {
+		mapReplayedWindow(record->frame, mw->decorationWindow);
+		mapReplayedWindow(record->resizer, mw->resizer);
+	}
+}
+
+/* Feeds a trace through handleEvent(), as fast as it goes, and reports how long that took */
+static void replayTrace(Display *display, Window root, GC gc, GC outlineGC, ManagedWindowPool *pool, double frameInterval) {
+	TraceRecord record;
+	XEvent ev;
+	unsigned long events = 0;
+	double nextFrame = 0;
+	double traceTime = 0;
+	const double start = currentTime();
+
+	replaying = 1;
+	XSetErrorHandler(countReplayError);
+
+	while (readTraceRecord(display, &record)) {
+		/* Frames are paced by the trace's clock, so every replay flushes at the same points */
+		if (!SLIST_EMPTY(&pool->dirty) && record.time >= nextFrame) {
+			flushFrame(display, root, gc, outlineGC, pool);
+			nextFrame = record.time + frameInterval;
+		}
+		traceTime = record.time;
+
+		if (record.type == TraceRecordClaim) {
+			replayClaim(display, &record, root, gc, pool);
+		}
+		else {
+			beginEventStats(display, record.event.type);
+			handleEvent(display, record.event, root, gc, outlineGC, pool);
+			endEventStats(display);
+			events++;
+		}
+
+		/* The trace is the only input, so the server's own events about the replay are dropped */
+		while (XPending(display)) {
+			XNextEvent(display, &ev);
+		}
+	}
+
+	if (!SLIST_EMPTY(&pool->dirty)) {
+		flushFrame(display, root, gc, outlineGC, pool);
+	}
+	XSync(display, False);
+
+	fprintf(stderr, "replayed %lu events (%.2fs of trace) in %.3fs, %lu errors\n",
+			events, traceTime, currentTime() - start, replayErrors);
+	dumpStats(pool, currentTime());
+}
+
+int main (int argc, const char * argv[]) {
+	double frameInterval = 1.0 / DEFAULT_FRAME_RATE;
+	const char *statsPath = NULL;
+	double statsInterval = 0;
+	const char *tracePath = NULL;
+	const char *replayPath = NULL;
+	int frameImages = 0;
+	int frameBackgrounds = 0;
+	int framePolicy = FrameStoreNone;
+	int ch;
+
+	while ((ch = getopt(argc, (char * const *)argv, "b:i:opr:R:s:t:u")) != -1) {
+		switch (ch) {
+			case 'b': {
+				framePolicy = parseFrameStorePolicy(optarg);
+				if (framePolicy < 0) {
+					usage();
 				}
 			} break;
-			case MapNotify: {
-				if (!ev.xmap.window) {
-					warnx("Recieved invalid window for event \"%s\"\n", event_names[ev.type]);
+			case 'i': {
+				statsInterval = atof(optarg);
+			} break;
+			case 'o': {
+				outlineMode = 1;
+			} break;
+			case 'p': {
+				frameBackgrounds = 1;
+			} break;
+			case 'r': {
+				/* Zero disables pacing, every drained batch of events is flushed immediately */
+				const double rate = atof(optarg);
+				if (rate < 0) {
+					usage();
 				}
-				claimWindow(display, ev.xmap.window, root, gc, pool);
+				frameInterval = rate ? 1.0 / rate : 0;
+			} break;
+			case 'R': {
+				replayPath = optarg;
+			} break;
+			case 's': {
+				statsPath = optarg;
+			} break;
+			case 't': {
+				tracePath = optarg;
 			} break;
-			default: {
-				warnx("Recieved unhandled event \"%s\"\n", event_names[ev.type]);
+			case 'u': {
+				frameImages = 1;
 			} break;
+			default:
+				usage();
+		}
+	}
+
+	if (tracePath && replayPath) {
+		usage();
+	}
+
+	Display *display;
+	int screen;
+
+	ManagedWindowPool *pool = createPool();
+
+	/* Set up */
+	display = XOpenDisplay(getenv("DISPLAY"));
+	if (!display) {
+		errx(EX_UNAVAILABLE, "Failed to open display, is X running?\n");
+	}
+
+	screen = DefaultScreen(display);
+	installErrorHandler();
+	internAtoms(display);
+	initializeSyncRequests(display);
+	/* A replay is only run for its report */
+	if (statsPath || replayPath) {
+		enableStats(display, statsPath ? statsPath : "-", statsInterval);
+	}
+
+	/* Find the window */
+	Window root = RootWindow(display, screen);
+
+	/* Every drawing call shares this one GC */
+	GC gc = resourcesForScreen(display, screen)->gc;
+	GC outlineGC = resourcesForScreen(display, screen)->outlineGC;
+	loadDecorationAtlas(display, gc);
+	setFrameStorePolicy(display, screen, framePolicy);
+	if (frameBackgrounds) {
+		enableFrameBackgrounds(display, screen, gc);
+	}
+	if (frameImages && !enableFrameImages(display, screen)) {
+		warnx("unable to copy the title font, drawing frames with Xlib");
+	}
+
+	if (replayPath) {
+		if (!startTraceReplay(display, replayPath, root)) {
+			exit(EX_NOINPUT);
 		}
+		replayTrace(display, root, gc, outlineGC, pool, frameInterval);
+		stopTraceReplay();
+	}
+	else {
+		/* Recording starts before adoption, so the trace has every window that gets claimed */
+		if (tracePath && !startTraceRecording(display, tracePath, root)) {
+			exit(EX_CANTCREAT);
+		}
+
+		/* Listen first, so that nothing mapped during adoption is missed, and frame new windows before they map */
+		if (!redirectRoot(display, root)) {
+			errx(EX_UNAVAILABLE, "Another window manager is already running");
+		}
+
+		/* Initial capture of all windows on startup */
+		claimAllWindows(display, root, gc, pool);
 
-		XFreeGC(display, gc);
+		eventLoop(display, root, gc, outlineGC, pool, frameInterval);
+		stopTraceRecording();
 	}
 
+	releaseSwapBatch(&swapBatch);
+	releaseFrameBackgrounds(display);
+	releaseFrameImages(display);
+	releaseDecorationAtlas(display);
+	releaseAllResources(display);
 	XCloseDisplay(display);
 	destroyPool(pool);
 
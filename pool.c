@@ -22,71 +22,424 @@
 
 #include <stdlib.h>
 #include <assert.h>
+#include <string.h>
 
 #include "pool.h"
+#include "resources.h"
+#include "timing.h"
+
+/* Must be a power of two, the index doubles whenever it gets 3/4 full */
+#define INITIAL_INDEX_BUCKETS (64)
+
+static unsigned int bucketForWindow(Window window, unsigned int buckets) {
+	/* XIDs are mostly sequential within a client, so spread them out (Knuth) */
+	unsigned int hash = (unsigned int)window * 2654435761U;
+	hash ^= hash >> 16;
+	return hash & (buckets - 1);
+}
+
+static void growIndex(ManagedWindowPool *pool) {
+	unsigned int newBuckets = pool->indexBuckets * 2;
+	struct WindowIndexEntry_t **newIndex = calloc(newBuckets, sizeof(struct WindowIndexEntry_t *));
+	assert(newIndex);
+
+	unsigned int i;
+	for (i = 0; i < pool->indexBuckets; i++) {
+		struct WindowIndexEntry_t *entry = pool->index[i];
+		while (entry) {
+			struct WindowIndexEntry_t *next = entry->next;
+			unsigned int bucket = bucketForWindow(entry->window, newBuckets);
+			entry->next = newIndex[bucket];
+			newIndex[bucket] = entry;
+			entry = next;
+		}
+	}
+
+	free(pool->index);
+	pool->index = newIndex;
+	pool->indexBuckets = newBuckets;
+}
+
+static void indexWindow(Window window, ManagedWindow *mw, ManagedWindowPool *pool) {
+	if (!window) {
+		return;
+	}
+
+	unsigned int bucket = bucketForWindow(window, pool->indexBuckets);
+	struct WindowIndexEntry_t *entry;
+	for (entry = pool->index[bucket]; entry; entry = entry->next) {
+		if (entry->window == window) {
+			LIST_REMOVE(entry, ownerEntries);
+			entry->managedWindow = mw;
+			LIST_INSERT_HEAD(&mw->indexEntries, entry, ownerEntries);
+			return;
+		}
+	}
+
+	if (pool->indexCount >= pool->indexBuckets - (pool->indexBuckets / 4)) {
+		growIndex(pool);
+		bucket = bucketForWindow(window, pool->indexBuckets);
+	}
+
+	entry = malloc(sizeof(struct WindowIndexEntry_t));
+	assert(entry);
+	entry->window = window;
+	entry->managedWindow = mw;
+	entry->next = pool->index[bucket];
+	pool->index[bucket] = entry;
+	LIST_INSERT_HEAD(&mw->indexEntries, entry, ownerEntries);
+	pool->indexCount++;
+}
+
+static void unindexWindow(Window window, ManagedWindowPool *pool) {
+	struct WindowIndexEntry_t **link = &pool->index[bucketForWindow(window, pool->indexBuckets)];
+	while (*link) {
+		if ((*link)->window == window) {
+			struct WindowIndexEntry_t *dead = *link;
+			*link = dead->next;
+			LIST_REMOVE(dead, ownerEntries);
+			free(dead);
+			pool->indexCount--;
+			return;
+		}
+		link = &(*link)->next;
+	}
+}
+
+static void unindexManagedWindow(ManagedWindow *mw, ManagedWindowPool *pool) {
+	while (!LIST_EMPTY(&mw->indexEntries)) {
+		unindexWindow(LIST_FIRST(&mw->indexEntries)->window, pool);
+	}
+}
+
+static int isSubwindow(ManagedWindow *mw, Window window) {
+	return window != mw->decorationWindow && window != mw->actualWindow && window != mw->resizer;
+}
 
 ManagedWindowPool *createPool(void) {
 	ManagedWindowPool *pool = calloc(1, sizeof(ManagedWindowPool));
 	assert(pool);
+
+	TAILQ_INIT(&pool->stack);
+	pool->indexBuckets = INITIAL_INDEX_BUCKETS;
+	pool->index = calloc(pool->indexBuckets, sizeof(struct WindowIndexEntry_t *));
+	assert(pool->index);
+
 	return pool;
 }
 
-void updateWindowTitle(Display *display, ManagedWindow *mw) {
-	if (mw->title) {
-		XFree(mw->title);
-		mw->title = NULL;
+void setWindowTitle(ManagedWindow *mw, const char *title) {
+	free(mw->title);
+	mw->title = NULL;
+
+	if (title) {
+		mw->title = malloc(strlen(title) + 1);
+		assert(mw->title);
+		strcpy(mw->title, title);
+	}
+	setTitleLayoutTitle(&mw->titleLayout, mw->title);
+}
+
+void updateWindowGeometry(ManagedWindow *mw, const XConfigureEvent *event) {
+	/* A configure we haven't sent yet is newer than anything the server can tell us */
+	if (event->window == mw->decorationWindow && !(mw->dirty & (DirtyPosition | DirtySize))) {
+		mw->x = event->x;
+		mw->y = event->y;
+		mw->width = event->width;
+		mw->height = event->height;
+	}
+	else if (event->window == mw->actualWindow && !(mw->dirty & DirtyClientSize)) {
+		mw->client_w = event->width;
+		mw->client_h = event->height;
 	}
-	XFetchName(display, mw->actualWindow, &(mw->title));
 }
 
-ManagedWindow *addWindowToPool(Display *display, Window decorationWindow, Window actualWindow, Window resizer, ManagedWindowPool *pool) {
+XWindowAttributes frameAttributes(const ManagedWindow *mw) {
+	XWindowAttributes attr;
+
+	memset(&attr, 0, sizeof(attr));
+	attr.x = mw->x;
+	attr.y = mw->y;
+	attr.width = mw->width;
+	attr.height = mw->height;
+
+	return attr;
+}
+
+void markWindowDirty(ManagedWindow *mw, int flags, ManagedWindowPool *pool) {
+	if (!mw->dirty) {
+		SLIST_INSERT_HEAD(&pool->dirty, mw, dirtyEntries);
+	}
+	mw->dirty |= flags;
+}
+
+void markWindowClean(ManagedWindow *mw, ManagedWindowPool *pool) {
+	if (mw->dirty) {
+		SLIST_REMOVE(&pool->dirty, mw, ManagedWindow_t, dirtyEntries);
+	}
+	mw->dirty = 0;
+}
+
+ManagedWindow *addWindowToPool(Display *display, Window decorationWindow, Window actualWindow, Window resizer, const char *title, ManagedWindowPool *pool) {
 	ManagedWindow *mw = calloc(1, sizeof(ManagedWindow));
 	assert(mw);
+	LIST_INIT(&mw->indexEntries);
 
 	mw->resizer = resizer;
 	mw->actualWindow = actualWindow;
 	mw->decorationWindow = decorationWindow;
-	mw->decorationBuffer = XdbeAllocateBackBufferName(display, decorationWindow, XdbeCopied);
-	updateWindowTitle(display, mw);
+	(void)display;
+	setWindowTitle(mw, title);
 
 	SLIST_INSERT_HEAD(&pool->windows, mw, entries);
 
+	/* A new frame is created on top of its siblings */
+	TAILQ_INSERT_HEAD(&pool->stack, mw, stackEntries);
+
+	indexWindow(decorationWindow, mw, pool);
+	indexWindow(actualWindow, mw, pool);
+	indexWindow(resizer, mw, pool);
+
 	return mw;
 }
 
+void addSubwindowsToPool(ManagedWindow *mw, const Window *children, unsigned int nchildren, ManagedWindowPool *pool) {
+	/* These are the subwindows that existed before we started listening for CreateNotify */
+	unsigned int i;
+	for (i = 0; i < nchildren; i++) {
+		indexWindow(children[i], mw, pool);
+	}
+}
+
 void removeWindowFromPool(Display *display, ManagedWindow *managedWindow, ManagedWindowPool *pool) {
-	(void)display;
 	SLIST_REMOVE(&pool->windows, managedWindow, ManagedWindow_t, entries);
+	TAILQ_REMOVE(&pool->stack, managedWindow, stackEntries);
+	unindexManagedWindow(managedWindow, pool);
+	markWindowClean(managedWindow, pool);
 
-	/* FIXME: I need to be dealloced before the decoration window */
-	/*
-	XdbeDeallocateBackBufferName(display, this->decorationBuffer);
-	*/
-	XFree(managedWindow->title);
+	if (pool->active == managedWindow) {
+		pool->active = NULL;
+	}
+
+	/* Normally already gone, since it must be released before the decoration window is destroyed */
+	releaseBackBuffer(display, managedWindow);
+	if (managedWindow->damage) {
+		XDestroyRegion(managedWindow->damage);
+	}
+	releaseTitleLayout(&managedWindow->titleLayout);
+	free(managedWindow->title);
 	free(managedWindow);
 }
 
-ManagedWindow *managedWindowForWindow(Display *display, Window window, ManagedWindowPool *pool) {
-	ManagedWindow *this;
-	SLIST_FOREACH(this, &pool->windows, entries) {
-		if (this->decorationWindow == window || this->actualWindow == window) {
-			return this;
+int raiseWindowInPool(Display *display, ManagedWindow *mw, ManagedWindowPool *pool) {
+	if (TAILQ_FIRST(&pool->stack) == mw) {
+		return 0;
+	}
+
+	TAILQ_REMOVE(&pool->stack, mw, stackEntries);
+	TAILQ_INSERT_HEAD(&pool->stack, mw, stackEntries);
+	pool->restackSerial = NextRequest(display);
+	XRaiseWindow(display, mw->decorationWindow);
+
+	return 1;
+}
+
+void restackPool(Display *display, ManagedWindowPool *pool) {
+	ManagedWindow *mw;
+	Window *frames;
+	int count = 0;
+
+	TAILQ_FOREACH(mw, &pool->stack, stackEntries) {
+		count++;
+	}
+	if (count < 2) {
+		return;
+	}
+
+	frames = malloc(count * sizeof(Window));
+	assert(frames);
+	count = 0;
+	TAILQ_FOREACH(mw, &pool->stack, stackEntries) {
+		frames[count++] = mw->decorationWindow;
+	}
+
+	/* The whole order in one call, instead of raising or lowering frames one at a time */
+	pool->restackSerial = NextRequest(display);
+	XRestackWindows(display, frames, count);
+	free(frames);
+}
+
+void restackWindowInPool(Display *display, ManagedWindow *mw, ManagedWindow *sibling, int detail, ManagedWindowPool *pool) {
+	const int lower = (detail == Below || detail == BottomIf);
+
+	if (sibling == mw) {
+		return;
+	}
+
+	/* Nothing here knows what overlaps what, so TopIf and Opposite raise, and BottomIf lowers */
+	TAILQ_REMOVE(&pool->stack, mw, stackEntries);
+	if (lower) {
+		if (sibling) {
+			TAILQ_INSERT_AFTER(&pool->stack, sibling, mw, stackEntries);
+		}
+		else {
+			TAILQ_INSERT_TAIL(&pool->stack, mw, stackEntries);
+		}
+	}
+	else {
+		if (sibling) {
+			TAILQ_INSERT_BEFORE(sibling, mw, stackEntries);
 		}
+		else {
+			TAILQ_INSERT_HEAD(&pool->stack, mw, stackEntries);
+		}
+	}
+
+	/*
+	 * XRestackWindows leaves the first frame where it is, so going to the very
+	 * top or bottom, past windows we don't manage, takes a raise or a lower too.
+	 */
+	if (!sibling && !lower) {
+		pool->restackSerial = NextRequest(display);
+		XRaiseWindow(display, mw->decorationWindow);
+	}
+	restackPool(display, pool);
+	if (!sibling && lower) {
+		pool->restackSerial = NextRequest(display);
+		XLowerWindow(display, mw->decorationWindow);
+	}
+}
+
+void stackWindowInPool(ManagedWindow *mw, const XConfigureEvent *event, ManagedWindowPool *pool) {
+	ManagedWindow *below;
+
+	/* Our own restacks are already in the model, and replaying their notifications would undo later ones */
+	if (event->window != mw->decorationWindow || (long)(event->serial - pool->restackSerial) < 0) {
+		return;
+	}
+
+	/* above is the sibling just below, or None at the bottom, and we can't place frames by anything else */
+	below = event->above ? managedWindowForWindow(event->above, pool) : NULL;
+	if (event->above && (!below || below->decorationWindow != event->above || below == mw)) {
+		return;
+	}
+
+	TAILQ_REMOVE(&pool->stack, mw, stackEntries);
+	if (below) {
+		TAILQ_INSERT_BEFORE(below, mw, stackEntries);
+	}
+	else {
+		TAILQ_INSERT_TAIL(&pool->stack, mw, stackEntries);
+	}
+}
+
+void acquireBackBuffer(Display *display, ManagedWindow *mw, ManagedWindowPool *pool) {
+	if (!mw->decorationBuffer) {
+		mw->decorationBuffer = XdbeAllocateBackBufferName(display, mw->decorationWindow, XdbeCopied);
+		countResource(ResourceTypeBackBuffer, 1);
+		markWindowDirty(mw, DirtyDecorations, pool);
+	}
+	touchBackBuffer(mw);
+}
+
+void touchBackBuffer(ManagedWindow *mw) {
+	mw->backBufferDue = currentTime() + BACK_BUFFER_IDLE_TIMEOUT;
+}
+
+void releaseBackBuffer(Display *display, ManagedWindow *mw) {
+	if (mw->decorationBuffer) {
+		XdbeDeallocateBackBufferName(display, mw->decorationBuffer);
+		countResource(ResourceTypeBackBuffer, -1);
+		mw->decorationBuffer = None;
+	}
+}
+
+double releaseIdleBackBuffers(Display *display, ManagedWindowPool *pool, double now) {
+	double next = -1;
+	ManagedWindow *mw;
 
-		unsigned int nchildren;
-		Window *children;
-		Window parent;
-		Window root;
-		XQueryTree(display, this->actualWindow, &root, &parent, &children, &nchildren);
-		for (int i = 0; i < nchildren; i++) {
-			if (children[i] == window) {
-				return this;
-			}
+	SLIST_FOREACH(mw, &pool->windows, entries) {
+		if (!mw->decorationBuffer) {
+			continue;
+		}
+
+		if (now >= mw->backBufferDue) {
+			releaseBackBuffer(display, mw);
+		}
+		else if (next < 0 || mw->backBufferDue - now < next) {
+			next = mw->backBufferDue - now;
+		}
+	}
+
+	return next;
+}
+
+/* Swaps for several frames at once, see flushDirtyWindows() */
+void queueSwap(SwapBatch *batch, Window window) {
+	if (batch->count == batch->capacity) {
+		batch->capacity = batch->capacity ? batch->capacity * 2 : 16;
+		batch->swaps = realloc(batch->swaps, batch->capacity * sizeof(XdbeSwapInfo));
+		assert(batch->swaps);
+	}
+
+	batch->swaps[batch->count].swap_window = window;
+	batch->swaps[batch->count].swap_action = XdbeCopied;
+	batch->count++;
+}
+
+int swapQueuedBuffers(Display *display, SwapBatch *batch) {
+	const int count = batch->count;
+
+	if (count) {
+		XdbeSwapBuffers(display, batch->swaps, count);
+		batch->count = 0;
+	}
+
+	return count;
+}
+
+void releaseSwapBatch(SwapBatch *batch) {
+	free(batch->swaps);
+	batch->swaps = NULL;
+	batch->count = 0;
+	batch->capacity = 0;
+}
+
+ManagedWindow *managedWindowForWindow(Window window, ManagedWindowPool *pool) {
+	struct WindowIndexEntry_t *entry;
+	for (entry = pool->index[bucketForWindow(window, pool->indexBuckets)]; entry; entry = entry->next) {
+		if (entry->window == window) {
+			return entry->managedWindow;
 		}
 	}
 	return NULL;
 }
 
+void reparentSubwindowInPool(Window window, Window parent, ManagedWindowPool *pool) {
+	ManagedWindow *newOwner = managedWindowForWindow(parent, pool);
+	if (newOwner && parent == newOwner->actualWindow) {
+		indexWindow(window, newOwner, pool);
+	}
+	else {
+		forgetSubwindowInPool(window, pool);
+	}
+}
+
+void addResourceToPool(XID resource, ManagedWindow *mw, ManagedWindowPool *pool) {
+	indexWindow(resource, mw, pool);
+}
+
+void forgetResourceInPool(XID resource, ManagedWindowPool *pool) {
+	unindexWindow(resource, pool);
+}
+
+void forgetSubwindowInPool(Window window, ManagedWindowPool *pool) {
+	ManagedWindow *owner = managedWindowForWindow(window, pool);
+	if (owner && isSubwindow(owner, window)) {
+		unindexWindow(window, pool);
+	}
+}
+
 void destroyPool(ManagedWindowPool *pool) {
 	ManagedWindow *this;
 	while (!SLIST_EMPTY(&pool->windows)) {
@@ -94,6 +447,16 @@ void destroyPool(ManagedWindowPool *pool) {
 		SLIST_REMOVE_HEAD(&pool->windows, entries);
 		free(this);
 	}
+
+	unsigned int i;
+	for (i = 0; i < pool->indexBuckets; i++) {
+		while (pool->index[i]) {
+			struct WindowIndexEntry_t *dead = pool->index[i];
+			pool->index[i] = dead->next;
+			free(dead);
+		}
+	}
+	free(pool->index);
 	free(pool);
 }
 
@@ -24,12 +24,33 @@
 #define classic_wm_pool_h
 
 #include <X11/Xlib.h>
+#include <X11/Xutil.h> /* Region */
 #include <X11/extensions/Xdbe.h>
+#include <X11/extensions/sync.h>
 #include <sys/queue.h>
 
+#include "decorations.h" /* TitleLayout */
+
+/* Seconds a back buffer is kept after its last use, see acquireBackBuffer() */
+#define BACK_BUFFER_IDLE_TIMEOUT   (2.0)
+
+/* What still has to be sent to the server for a window at the next frame */
+typedef enum {
+	DirtyPosition    = 1 << 0,
+	DirtySize        = 1 << 1,
+	DirtyDecorations = 1 << 2, /* Repaint the whole frame */
+	DirtyDamage      = 1 << 3, /* Repaint only what damage covers */
+	DirtyResizer     = 1 << 4,
+	DirtyClientSize  = 1 << 5  /* Held back until the client may be resized again */
+} DirtyFlags;
+
 struct ManagedWindow_t {
 	Window decorationWindow;
-	XdbeBackBuffer decorationBuffer;
+	XdbeBackBuffer decorationBuffer;    /* None unless something is animating, see acquireBackBuffer() */
+	double backBufferDue;               /* when an unused back buffer is released */
+	Pixmap background;                  /* the frame's background_pixmap, see background.h */
+	unsigned int backgroundWidth;
+	unsigned int backgroundHeight;
 	Window actualWindow;
 	Window resizer;
 
@@ -39,31 +60,157 @@ struct ManagedWindow_t {
 	unsigned int last_x;
 	unsigned int last_y;
 
-	/* The minimum size hints are cached for performance */
+	/*
+	 * Frame position and size, and the client's size within it. These are
+	 * authoritative, updated by our own move/resize calls and ConfigureNotify,
+	 * so that redraws and hit tests never need to ask the server.
+	 */
+	int x;
+	int y;
+	unsigned int width;
+	unsigned int height;
+	unsigned int client_w;
+	unsigned int client_h;
+	unsigned int border_width;    /* the client's own, inside the frame */
+
+	/*
+	 * WM_NORMAL_HINTS and WM_PROTOCOLS, cached along with the title, and
+	 * refreshed only by PropertyNotify, see properties.h
+	 */
 	unsigned int min_w;
 	unsigned int min_h;
+	unsigned int max_w;
+	unsigned int max_h;
+	unsigned int base_w;
+	unsigned int base_h;
+	unsigned int inc_w;
+	unsigned int inc_h;
+	int protocols;
+
+	/* Expose rectangles collected until the last one in the series arrives */
+	Region damage;
+
+	/* Times the frame has been repainted, see stats.h */
+	unsigned long redraws;
+
+	/* DirtyFlags, and whether this is on the pool's dirty list */
+	int dirty;
+	SLIST_ENTRY(ManagedWindow_t) dirtyEntries;
 
 	SLIST_ENTRY(ManagedWindow_t) entries;
+	TAILQ_ENTRY(ManagedWindow_t) stackEntries;
+
+	/* Every XID indexed to this window, so unclaiming it doesn't sweep the whole index */
+	LIST_HEAD(indexlist, WindowIndexEntry_t) indexEntries;
 	char *title;
+	TitleLayout titleLayout;
 
 	int collapsed;
+
+	/* Whether the passive click-to-focus grab is installed on actualWindow */
+	int grabbed;
+
+	/* Client resize pacing, see syncrequest.h */
+	XSyncCounter syncCounter;
+	XSyncAlarm syncAlarm;
+	XSyncValue syncValue;
+	int syncSeeded;
+	int syncPending;
+	double clientResizeDue;
 };
 
 typedef struct ManagedWindow_t ManagedWindow;
 
+/* One chained bucket entry of the XID index */
+struct WindowIndexEntry_t {
+	Window window;
+	ManagedWindow *managedWindow;
+	struct WindowIndexEntry_t *next;
+	LIST_ENTRY(WindowIndexEntry_t) ownerEntries;    /* in managedWindow's indexEntries */
+};
+
 struct ManagedWindowPool_t {
 	SLIST_HEAD(windowlist, ManagedWindow_t) windows;
 	ManagedWindow *active;
+
+	/* Windows with work deferred until the next frame */
+	SLIST_HEAD(dirtylist, ManagedWindow_t) dirty;
+
+	/*
+	 * Frames from top to bottom, kept by our own restacks and by the
+	 * ConfigureNotify of everyone else's. Windows we don't manage aren't in
+	 * it, so it only orders frames relative to each other.
+	 */
+	TAILQ_HEAD(stack, ManagedWindow_t) stack;
+	unsigned long restackSerial;    /* of our last restack, older notifications are stale */
+
+	/*
+	 * Every XID we care about (frames, clients, resizers and the clients'
+	 * immediate subwindows) hashes to its ManagedWindow, so that lookups
+	 * never have to ask the server anything.
+	 */
+	struct WindowIndexEntry_t **index;
+	unsigned int indexBuckets;
+	unsigned int indexCount;
 };
 
 typedef struct ManagedWindowPool_t ManagedWindowPool;
 
 ManagedWindowPool *createPool(void);
-ManagedWindow *addWindowToPool(Display *display, Window decorationWindow, Window actualWindow, Window resizer, ManagedWindowPool *pool);
+ManagedWindow *addWindowToPool(Display *display, Window decorationWindow, Window actualWindow, Window resizer, const char *title, ManagedWindowPool *pool);
+void addSubwindowsToPool(ManagedWindow *mw, const Window *children, unsigned int nchildren, ManagedWindowPool *pool);
 void removeWindowFromPool(Display *display, ManagedWindow *managedWindow, ManagedWindowPool *pool);
 void destroyPool(ManagedWindowPool *pool);
-ManagedWindow *managedWindowForWindow(Display *display, Window window, ManagedWindowPool *pool);
+ManagedWindow *managedWindowForWindow(Window window, ManagedWindowPool *pool);
+void reparentSubwindowInPool(Window window, Window parent, ManagedWindowPool *pool);
+void forgetSubwindowInPool(Window window, ManagedWindowPool *pool);
+/* Other XIDs that events name, such as sync alarms, found with managedWindowForWindow() too */
+void addResourceToPool(XID resource, ManagedWindow *mw, ManagedWindowPool *pool);
+void forgetResourceInPool(XID resource, ManagedWindowPool *pool);
 void printPool(ManagedWindowPool *pool);
-void updateWindowTitle(Display *display, ManagedWindow *mw);
+void setWindowTitle(ManagedWindow *mw, const char *title);
+void updateWindowGeometry(ManagedWindow *mw, const XConfigureEvent *event);
+XWindowAttributes frameAttributes(const ManagedWindow *mw);
+void markWindowDirty(ManagedWindow *mw, int flags, ManagedWindowPool *pool);
+void markWindowClean(ManagedWindow *mw, ManagedWindowPool *pool);
+
+/* Returns 0, without sending anything, if the frame is already on top */
+int raiseWindowInPool(Display *display, ManagedWindow *mw, ManagedWindowPool *pool);
+void restackPool(Display *display, ManagedWindowPool *pool);
+/* Stacks a frame as a ConfigureRequest asks, by a sibling's frame, or at the top or bottom */
+void restackWindowInPool(Display *display, ManagedWindow *mw, ManagedWindow *sibling, int detail, ManagedWindowPool *pool);
+void stackWindowInPool(ManagedWindow *mw, const XConfigureEvent *event, ManagedWindowPool *pool);
+
+/*
+ * Frames are double buffered only while something is animating them, such
+ * as an interactive resize or a focus change. Everything else paints the
+ * window directly, and buffers idle for BACK_BUFFER_IDLE_TIMEOUT go back to
+ * the server. A fresh buffer has no contents, so acquiring one repaints the
+ * whole frame.
+ */
+void acquireBackBuffer(Display *display, ManagedWindow *mw, ManagedWindowPool *pool);
+void touchBackBuffer(ManagedWindow *mw);
+void releaseBackBuffer(Display *display, ManagedWindow *mw);
+
+/* Returns seconds until the next buffer goes idle, or negative if there are none */
+double releaseIdleBackBuffers(Display *display, ManagedWindowPool *pool, double now);
+
+/*
+ * Frames repainted in the same pass are flipped together: each is drawn
+ * into its back buffer as it comes up, and one XdbeSwapBuffers request
+ * shows them all at once.
+ */
+struct SwapBatch_t {
+	XdbeSwapInfo *swaps;
+	int count;
+	int capacity;
+};
+
+typedef struct SwapBatch_t SwapBatch;
+
+void queueSwap(SwapBatch *batch, Window window);
+/* Returns how many windows were swapped, leaving the batch empty */
+int swapQueuedBuffers(Display *display, SwapBatch *batch);
+void releaseSwapBatch(SwapBatch *batch);
 
 #endif
@@ -0,0 +1,229 @@
+/*
+ * Copyright (c) 2012 Daniel Loffgren
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <X11/Xatom.h>  /* XA_WM_NAME */
+
+#include "atoms.h"
+#include "properties.h"
+
+#define MAX_TITLE_LENGTH           (1024)  /* bytes of _NET_WM_NAME worth fetching */
+
+int protocolForAtom(Atom atom) {
+	if (atom == atomNamed(AtomWMDeleteWindow)) {
+		return ProtocolDeleteWindow;
+	}
+	if (atom == atomNamed(AtomWMTakeFocus)) {
+		return ProtocolTakeFocus;
+	}
+	if (atom == atomNamed(AtomNetWMSyncRequest)) {
+		return ProtocolSyncRequest;
+	}
+	return 0;
+}
+
+/* The titlebar font is Latin-1, so anything beyond it is drawn as '?' */
+char *titleFromUTF8(const char *utf8, int length) {
+	const unsigned char *in = (const unsigned char *)utf8;
+	char *title = malloc(length + 1);
+	int i = 0;
+	int out = 0;
+
+	assert(title);
+	while (i < length) {
+		unsigned long c = in[i++];
+		int extra = (c >= 0xF0) ? 3 : (c >= 0xE0) ? 2 : (c >= 0xC0) ? 1 : 0;
+		int valid = (c < 0x80 || extra);
+
+		if (extra) {
+			c &= 0x3F >> extra;
+			for (; extra && i < length && (in[i] & 0xC0) == 0x80; extra--, i++) {
+				c = (c << 6) | (in[i] & 0x3F);
+			}
+			/* Cut short by the end of the string, or by another lead byte */
+			valid = !extra;
+		}
+
+		if (c == 0) {
+			continue;
+		}
+		title[out++] = (valid && c <= 0xFF) ? (char)c : '?';
+	}
+	title[out] = '\0';
+
+	return title;
+}
+
+char *fetchWindowTitle(Display *display, Window window) {
+	Atom type;
+	int format;
+	unsigned long nitems;
+	unsigned long remaining;
+	unsigned char *data = NULL;
+	char *title = NULL;
+	char *name;
+
+	/* Prefer the EWMH name, which isn't limited to Latin-1 */
+	if (XGetWindowProperty(display, window, atomNamed(AtomNetWMName), 0, MAX_TITLE_LENGTH / 4, False, atomNamed(AtomUTF8String),
+						   &type, &format, &nitems, &remaining, &data) == Success && data) {
+		if (format == 8 && nitems) {
+			title = titleFromUTF8((const char *)data, (int)nitems);
+		}
+		XFree(data);
+	}
+
+	if (!title && XFetchName(display, window, &name) && name) {
+		title = malloc(strlen(name) + 1);
+		assert(title);
+		strcpy(title, name);
+		XFree(name);
+	}
+
+	return title;
+}
+
+int fetchWindowProtocols(Display *display, Window window) {
+	Atom *atoms;
+	int natoms;
+	int protocols = 0;
+	int i;
+
+	if (XGetWMProtocols(display, window, &atoms, &natoms)) {
+		for (i = 0; i < natoms; i++) {
+			protocols |= protocolForAtom(atoms[i]);
+		}
+		XFree(atoms);
+	}
+
+	return protocols;
+}
+
+XID fetchSyncCounter(Display *display, Window window) {
+	Atom type;
+	int format;
+	unsigned long nitems;
+	unsigned long remaining;
+	unsigned char *data = NULL;
+	XID counter = None;
+
+	if (XGetWindowProperty(display, window, atomNamed(AtomNetWMSyncRequestCounter), 0, 1, False, XA_CARDINAL,
+						   &type, &format, &nitems, &remaining, &data) == Success && data) {
+		if (format == 32 && nitems == 1) {
+			/* Xlib hands back format 32 properties as longs */
+			counter = (XID)*(unsigned long *)data;
+		}
+		XFree(data);
+	}
+
+	return counter;
+}
+
+static unsigned int positive(int value) {
+	return value > 0 ? (unsigned int)value : 0;
+}
+
+void setWindowHints(ManagedWindow *mw, const XSizeHints *hints, long supplied) {
+	const long flags = hints->flags & supplied;
+
+	mw->min_w = mw->min_h = 0;
+	mw->max_w = mw->max_h = 0;
+	mw->base_w = mw->base_h = 0;
+	mw->inc_w = mw->inc_h = 0;
+
+	/* ICCCM: each of the minimum and base sizes stands in for the other when it's missing */
+	if (flags & PMinSize) {
+		mw->min_w = positive(hints->min_width);
+		mw->min_h = positive(hints->min_height);
+	}
+	if (flags & PBaseSize) {
+		mw->base_w = positive(hints->base_width);
+		mw->base_h = positive(hints->base_height);
+	}
+	if (!(flags & PMinSize)) {
+		mw->min_w = mw->base_w;
+		mw->min_h = mw->base_h;
+	}
+	if (!(flags & PBaseSize)) {
+		mw->base_w = mw->min_w;
+		mw->base_h = mw->min_h;
+	}
+
+	if (flags & PMaxSize) {
+		mw->max_w = positive(hints->max_width);
+		mw->max_h = positive(hints->max_height);
+	}
+	if (flags & PResizeInc) {
+		mw->inc_w = positive(hints->width_inc);
+		mw->inc_h = positive(hints->height_inc);
+	}
+}
+
+static int sameTitle(const char *a, const char *b) {
+	if (!a || !b) {
+		return a == b;
+	}
+	return !strcmp(a, b);
+}
+
+int refreshWindowProperty(Display *display, ManagedWindow *mw, Atom property) {
+	if (property == XA_WM_NAME || property == atomNamed(AtomNetWMName)) {
+		char *title = fetchWindowTitle(display, mw->actualWindow);
+		const int changed = !sameTitle(title, mw->title);
+
+		if (changed) {
+			setWindowTitle(mw, title);
+		}
+		free(title);
+		return changed ? PropertyTitle : 0;
+	}
+
+	if (property == XA_WM_NORMAL_HINTS) {
+		XSizeHints hints;
+		long supplied = 0;
+
+		memset(&hints, 0, sizeof(hints));
+		if (!XGetWMNormalHints(display, mw->actualWindow, &hints, &supplied)) {
+			supplied = 0;
+		}
+		setWindowHints(mw, &hints, supplied);
+		return PropertyHints;
+	}
+
+	if (property == atomNamed(AtomWMProtocols)) {
+		const int protocols = fetchWindowProtocols(display, mw->actualWindow);
+		int changed = PropertyProtocols;
+
+		if ((protocols ^ mw->protocols) & ProtocolSyncRequest) {
+			changed |= PropertySyncCounter;
+		}
+		mw->protocols = protocols;
+		return changed;
+	}
+
+	if (property == atomNamed(AtomNetWMSyncRequestCounter)) {
+		return PropertySyncCounter;
+	}
+
+	return 0;
+}
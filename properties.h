@@ -0,0 +1,63 @@
+/*
+ * Copyright (c) 2012 Daniel Loffgren
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef classic_wm_properties_h
+#define classic_wm_properties_h
+
+#include <X11/Xlib.h>
+#include <X11/Xutil.h> /* XSizeHints */
+
+#include "pool.h"
+
+/*
+ * The client properties the frame depends on are fetched once when the
+ * window is claimed, and after that only when PropertyNotify says one of
+ * them changed, so nothing else ever has to ask the server for them.
+ */
+
+/* WM_PROTOCOLS the client participates in */
+typedef enum {
+	ProtocolDeleteWindow = 1 << 0,
+	ProtocolTakeFocus    = 1 << 1,
+	ProtocolSyncRequest  = 1 << 2
+} Protocol;
+
+/* What a PropertyNotify invalidated */
+typedef enum {
+	PropertyTitle       = 1 << 0,
+	PropertyHints       = 1 << 1,
+	PropertyProtocols   = 1 << 2,
+	PropertySyncCounter = 1 << 3
+} PropertyChange;
+
+int protocolForAtom(Atom atom);
+char *titleFromUTF8(const char *utf8, int length);
+
+/* Synchronous fetches, for claiming one window, or a property that changed */
+char *fetchWindowTitle(Display *display, Window window);
+int fetchWindowProtocols(Display *display, Window window);
+XID fetchSyncCounter(Display *display, Window window);
+
+void setWindowHints(ManagedWindow *mw, const XSizeHints *hints, long supplied);
+int refreshWindowProperty(Display *display, ManagedWindow *mw, Atom property);
+
+#endif
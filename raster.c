@@ -0,0 +1,338 @@
+/*
+ * Copyright (c) 2012 Daniel Loffgren
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "raster.h"
+
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+#define MAX(a, b) ((a) > (b) ? (a) : (b))
+
+static int defaultAdvances[256];
+
+/* Whether a primitive in this box can skip the clip test per pixel, and whether it draws at all */
+typedef enum {
+	ClipOut = 0,
+	ClipIn,
+	ClipPartial
+} ClipResult;
+
+static ClipResult clipBox(const Canvas *canvas, int x, int y, int width, int height) {
+	if (!canvas->clip) {
+		return ClipIn;
+	}
+
+	switch (XRectInRegion(canvas->clip, x, y, width, height)) {
+		case RectangleIn:
+			return ClipIn;
+		case RectangleOut:
+			return ClipOut;
+		default:
+			return ClipPartial;
+	}
+}
+
+static void plot(Canvas *canvas, int x, int y, CanvasColor color, ClipResult clip) {
+	unsigned char *byte;
+	unsigned char bit;
+
+	if (x < 0 || y < 0 || x >= canvas->width || y >= canvas->height) {
+		return;
+	}
+	if (clip == ClipPartial && !XPointInRegion(canvas->clip, x, y)) {
+		return;
+	}
+
+	/* Most significant bit first, the same as PBM */
+	byte = &canvas->bits[y * canvas->stride + (x >> 3)];
+	bit = 0x80 >> (x & 7);
+	if (color == CanvasBlack) {
+		*byte |= bit;
+	}
+	else {
+		*byte &= ~bit;
+	}
+}
+
+/* Pixels left through right - 1 of one row, a byte at a time where it can */
+static void fillSpan(Canvas *canvas, CanvasColor color, int row, int left, int right) {
+	unsigned char *line = &canvas->bits[row * canvas->stride];
+	const int first = left >> 3;
+	const int last = (right - 1) >> 3;
+	const unsigned char leading = 0xff >> (left & 7);
+	const unsigned char trailing = 0xff << (7 - ((right - 1) & 7));
+	const unsigned char fill = color == CanvasBlack ? 0xff : 0x00;
+
+	if (first == last) {
+		const unsigned char mask = leading & trailing;
+		line[first] = (line[first] & ~mask) | (fill & mask);
+		return;
+	}
+
+	line[first] = (line[first] & ~leading) | (fill & leading);
+	memset(&line[first + 1], fill, last - first - 1);
+	line[last] = (line[last] & ~trailing) | (fill & trailing);
+}
+
+static void fillBox(Canvas *canvas, CanvasColor color, int x, int y, int width, int height) {
+	ClipResult clip = clipBox(canvas, x, y, width, height);
+	int left = MAX(x, 0);
+	int right = MIN(x + width, canvas->width);
+	int top = MAX(y, 0);
+	int bottom = MIN(y + height, canvas->height);
+	int row;
+	int column;
+
+	if (clip == ClipOut) {
+		return;
+	}
+
+	/* Damage is usually one rectangle, in which case its extents are all of it */
+	if (clip == ClipPartial) {
+		XRectangle extents;
+		XClipBox(canvas->clip, &extents);
+		left = MAX(left, extents.x);
+		right = MIN(right, extents.x + extents.width);
+		top = MAX(top, extents.y);
+		bottom = MIN(bottom, extents.y + extents.height);
+		if (left >= right || top >= bottom) {
+			return;
+		}
+		clip = clipBox(canvas, left, top, right - left, bottom - top);
+	}
+
+	if (left >= right) {
+		return;
+	}
+
+	for (row = top; row < bottom; row++) {
+		if (clip == ClipIn) {
+			fillSpan(canvas, color, row, left, right);
+			continue;
+		}
+		for (column = left; column < right; column++) {
+			plot(canvas, column, row, color, clip);
+		}
+	}
+}
+
+/* A zero width line, with both ends drawn, as the server draws one */
+static void drawLine(Canvas *canvas, CanvasColor color, int x1, int y1, int x2, int y2) {
+	const int dx = abs(x2 - x1);
+	const int dy = -abs(y2 - y1);
+	const int sx = x1 < x2 ? 1 : -1;
+	const int sy = y1 < y2 ? 1 : -1;
+	int error = dx + dy;
+	ClipResult clip;
+
+	/* Straight lines are most of what decorations draw */
+	if (x1 == x2 || y1 == y2) {
+		fillBox(canvas, color, MIN(x1, x2), MIN(y1, y2), dx + 1, -dy + 1);
+		return;
+	}
+
+	clip = clipBox(canvas, MIN(x1, x2), MIN(y1, y2), dx + 1, -dy + 1);
+	if (clip == ClipOut) {
+		return;
+	}
+
+	for (;;) {
+		plot(canvas, x1, y1, color, clip);
+		if (x1 == x2 && y1 == y2) {
+			break;
+		}
+		if (2 * error >= dy) {
+			error += dy;
+			x1 += sx;
+		}
+		if (2 * error <= dx) {
+			error += dx;
+			y1 += sy;
+		}
+	}
+}
+
+static void rasterFillRectangles(Canvas *canvas, CanvasColor color, const XRectangle *rects, int count) {
+	int i;
+	for (i = 0; i < count; i++) {
+		fillBox(canvas, color, rects[i].x, rects[i].y, rects[i].width, rects[i].height);
+	}
+}
+
+static void rasterDrawRectangles(Canvas *canvas, CanvasColor color, const XRectangle *rects, int count) {
+	int i;
+
+	/* An outlined rectangle covers one more pixel each way than a filled one */
+	for (i = 0; i < count; i++) {
+		const int x = rects[i].x;
+		const int y = rects[i].y;
+		const int width = rects[i].width;
+		const int height = rects[i].height;
+
+		fillBox(canvas, color, x, y, width + 1, 1);
+		fillBox(canvas, color, x, y + height, width + 1, 1);
+		fillBox(canvas, color, x, y, 1, height + 1);
+		fillBox(canvas, color, x + width, y, 1, height + 1);
+	}
+}
+
+static void rasterDrawSegments(Canvas *canvas, CanvasColor color, const XSegment *segments, int count) {
+	int i;
+	for (i = 0; i < count; i++) {
+		drawLine(canvas, color, segments[i].x1, segments[i].y1, segments[i].x2, segments[i].y2);
+	}
+}
+
+static void rasterDrawPoints(Canvas *canvas, CanvasColor color, const XPoint *points, int count) {
+	int i;
+	for (i = 0; i < count; i++) {
+		plot(canvas, points[i].x, points[i].y, color, clipBox(canvas, points[i].x, points[i].y, 1, 1));
+	}
+}
+
+/* Text is transparent, like XDrawText(), so only the set bits of the glyph are drawn */
+static void drawGlyph(Canvas *canvas, const RasterFont *font, unsigned char c, int x, int y) {
+	const int left = x - font->origin;
+	const int top = y - font->ascent;
+	const ClipResult clip = clipBox(canvas, left, top, font->cellWidth, font->ascent + font->descent);
+	int row;
+	int column;
+
+	if (clip == ClipOut) {
+		return;
+	}
+
+	for (row = 0; row < font->ascent + font->descent; row++) {
+		const unsigned char *line = &font->bits[row * font->stride];
+		for (column = 0; column < font->cellWidth; column++) {
+			const int bit = c * font->cellWidth + column;
+			if ((line[bit >> 3] >> (7 - (bit & 7))) & 1) {
+				plot(canvas, left + column, top + row, CanvasBlack, clip);
+			}
+		}
+	}
+}
+
+static void rasterDrawText(Canvas *canvas, int x, int y, const XTextItem *items, int count) {
+	int i;
+	int j;
+
+	for (i = 0; i < count; i++) {
+		x += items[i].delta;
+		for (j = 0; j < items[i].nchars; j++) {
+			const unsigned char c = items[i].chars[j];
+			const int advance = canvas->advances[c];
+
+			if (canvas->font) {
+				drawGlyph(canvas, canvas->font, c, x, y);
+			}
+			else if (c != ' ' && advance > 1) {
+				fillBox(canvas, CanvasBlack, x, y - RASTER_GLYPH_HEIGHT, advance - 1, RASTER_GLYPH_HEIGHT);
+			}
+			x += advance;
+		}
+	}
+}
+
+static const CanvasOps rasterOps = {
+	rasterFillRectangles,
+	rasterDrawRectangles,
+	rasterDrawSegments,
+	rasterDrawPoints,
+	rasterDrawText,
+	NULL,
+	NULL,
+};
+
+int createRasterCanvas(Canvas *canvas, int width, int height, const int *advances) {
+	memset(canvas, 0, sizeof(Canvas));
+
+	if (!advances) {
+		int i;
+		for (i = 0; i < 256; i++) {
+			defaultAdvances[i] = RASTER_DEFAULT_ADVANCE;
+		}
+		advances = defaultAdvances;
+	}
+
+	canvas->stride = (width + 7) / 8;
+	canvas->bits = calloc(height, canvas->stride);
+	if (!canvas->bits) {
+		return 0;
+	}
+
+	canvas->ops = &rasterOps;
+	canvas->advances = advances;
+	canvas->width = width;
+	canvas->height = height;
+
+	return 1;
+}
+
+void releaseRasterCanvas(Canvas *canvas) {
+	free(canvas->bits);
+	memset(canvas, 0, sizeof(Canvas));
+}
+
+void setRasterClip(Canvas *canvas, Region clip) {
+	canvas->clip = clip;
+}
+
+void clearRasterCanvas(Canvas *canvas) {
+	memset(canvas->bits, 0, canvas->height * canvas->stride);
+}
+
+void setRasterFont(Canvas *canvas, const RasterFont *font) {
+	canvas->font = font;
+}
+
+int rasterPixel(const Canvas *canvas, int x, int y) {
+	if (x < 0 || y < 0 || x >= canvas->width || y >= canvas->height) {
+		return 0;
+	}
+	return (canvas->bits[y * canvas->stride + (x >> 3)] >> (7 - (x & 7))) & 1;
+}
+
+int compareRasterCanvases(const Canvas *a, const Canvas *b) {
+	int differences = 0;
+	int x;
+	int y;
+
+	if (a->width != b->width || a->height != b->height) {
+		return -1;
+	}
+
+	for (y = 0; y < a->height; y++) {
+		for (x = 0; x < a->width; x++) {
+			differences += rasterPixel(a, x, y) != rasterPixel(b, x, y);
+		}
+	}
+
+	return differences;
+}
+
+void writeRasterPBM(const Canvas *canvas, FILE *out) {
+	/* Padding bits at the end of each row are never set, which is what PBM wants */
+	fprintf(out, "P4\n%d %d\n", canvas->width, canvas->height);
+	fwrite(canvas->bits, canvas->stride, canvas->height, out);
+}
@@ -0,0 +1,66 @@
+/*
+ * Copyright (c) 2012 Daniel Loffgren
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef classic_wm_raster_h
+#define classic_wm_raster_h
+
+#include <stdio.h>
+
+#include "canvas.h"
+
+/*
+ * An in-memory 1-bit canvas, for rendering decorations without a server.
+ * Lines and rectangles land on the same pixels a server would draw them on.
+ * Text is drawn from a RasterFont, a copy of a server font's glyphs, or
+ * without one, greeked as one black box per character, at the advances the
+ * canvas was created with.
+ */
+#define RASTER_DEFAULT_ADVANCE     (7)     /* px per character, when no advances are given */
+#define RASTER_GLYPH_HEIGHT        (9)     /* px above the baseline */
+
+/* Every glyph of a one byte font, each in a cell of the same width, with its origin at the same x */
+struct RasterFont_t {
+	unsigned char *bits;       /* the cells side by side, laid out like a canvas */
+	int stride;
+	int cellWidth;
+	int origin;                /* px from the left of a cell to the glyph origin */
+	int ascent;
+	int descent;
+};
+
+typedef struct RasterFont_t RasterFont;
+
+/* advances may be NULL for RASTER_DEFAULT_ADVANCE, otherwise it must outlive the canvas */
+int createRasterCanvas(Canvas *canvas, int width, int height, const int *advances);
+void releaseRasterCanvas(Canvas *canvas);
+
+/* Everything after this is clipped to the region, like XSetRegion(), or not at all if NULL */
+void setRasterClip(Canvas *canvas, Region clip);
+void clearRasterCanvas(Canvas *canvas);
+void setRasterFont(Canvas *canvas, const RasterFont *font);
+
+int rasterPixel(const Canvas *canvas, int x, int y);
+/* The number of pixels that differ, or -1 if the sizes do */
+int compareRasterCanvases(const Canvas *a, const Canvas *b);
+void writeRasterPBM(const Canvas *canvas, FILE *out);
+
+#endif
@@ -0,0 +1,166 @@
+/*
+ * Copyright (c) 2012 Daniel Loffgren
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <assert.h>
+#include <err.h>
+#include <stdlib.h>
+
+#include "decorations.h"
+#include "resources.h"
+
+static ScreenResources *screens;
+static int screenCount;
+static unsigned long liveCounts[ResourceTypeCount];
+
+static const char *resourceNames[ResourceTypeCount] = {
+	"gcs",
+	"fonts",
+	"cursors",
+	"pixmaps",
+	"backbuffers",
+};
+
+/* What XTextWidth would use for c, or NULL for a glyph the font doesn't have */
+static const XCharStruct *glyphMetrics(const XFontStruct *font, unsigned int c) {
+	const XCharStruct *metrics;
+
+	if (c < font->min_char_or_byte2 || c > font->max_char_or_byte2) {
+		return NULL;
+	}
+
+	metrics = &font->per_char[c - font->min_char_or_byte2];
+	if (!metrics->width && !metrics->lbearing && !metrics->rbearing && !metrics->ascent && !metrics->descent) {
+		return NULL;
+	}
+	return metrics;
+}
+
+static void loadAdvances(const XFontStruct *font, int *advances) {
+	const XCharStruct *fallback;
+	const XCharStruct *metrics;
+	unsigned int c;
+
+	/* Without per character metrics (or for a two byte font), everything is max_bounds wide */
+	for (c = 0; c < 256; c++) {
+		advances[c] = font->max_bounds.width;
+	}
+	if (!font->per_char || font->min_byte1 || font->max_byte1) {
+		return;
+	}
+
+	fallback = glyphMetrics(font, font->default_char);
+	for (c = 0; c < 256; c++) {
+		metrics = glyphMetrics(font, c);
+		if (!metrics) {
+			metrics = fallback;
+		}
+		advances[c] = metrics ? metrics->width : 0;
+	}
+}
+
+static void loadScreenResources(Display *display, int screen, ScreenResources *res) {
+	XGCValues values;
+
+	res->white = XWhitePixel(display, screen);
+	res->black = XBlackPixel(display, screen);
+
+	res->font = XLoadQueryFont(display, TITLEBAR_FONTNAME);
+	if (!res->font) {
+		warnx("unable to load preferred font: " TITLEBAR_FONTNAME " using fixed");
+		res->font = XLoadQueryFont(display, "fixed");
+		assert(res->font);
+	}
+	countResource(ResourceTypeFont, 1);
+	loadAdvances(res->font, res->advances);
+
+	/* The font never changes, so it can be baked into the GC once */
+	values.foreground = res->black;
+	values.background = res->white;
+	values.font = res->font->fid;
+	/* Decorations are blitted from pixmaps, which must not generate NoExpose */
+	values.graphics_exposures = False;
+	res->gc = XCreateGC(display, RootWindow(display, screen), GCForeground | GCBackground | GCFont | GCGraphicsExposures, &values);
+	countResource(ResourceTypeGC, 1);
+
+	/* Drawing it twice in the same place erases it, whatever is underneath */
+	values.function = GXxor;
+	values.foreground = res->white ^ res->black;
+	values.subwindow_mode = IncludeInferiors;
+	res->outlineGC = XCreateGC(display, RootWindow(display, screen), GCFunction | GCForeground | GCSubwindowMode | GCGraphicsExposures, &values);
+	countResource(ResourceTypeGC, 1);
+
+	res->cursor = XCreateFontCursor(display, XC_left_ptr);
+	countResource(ResourceTypeCursor, 1);
+}
+
+ScreenResources *resourcesForScreen(Display *display, int screen) {
+	if (!screens) {
+		screenCount = ScreenCount(display);
+		screens = calloc(screenCount, sizeof(ScreenResources));
+		assert(screens);
+	}
+
+	assert(screen >= 0 && screen < screenCount);
+	ScreenResources *res = &screens[screen];
+	if (!res->gc) {
+		loadScreenResources(display, screen, res);
+	}
+
+	return res;
+}
+
+void releaseAllResources(Display *display) {
+	int i;
+	for (i = 0; i < screenCount; i++) {
+		ScreenResources *res = &screens[i];
+		if (res->gc) {
+			XFreeGC(display, res->gc);
+			XFreeGC(display, res->outlineGC);
+			countResource(ResourceTypeGC, -2);
+			XFreeFont(display, res->font);
+			countResource(ResourceTypeFont, -1);
+			XFreeCursor(display, res->cursor);
+			countResource(ResourceTypeCursor, -1);
+		}
+	}
+
+	free(screens);
+	screens = NULL;
+	screenCount = 0;
+}
+
+void countResource(ResourceType type, int delta) {
+	liveCounts[type] += delta;
+}
+
+unsigned long liveResourceCount(ResourceType type) {
+	return liveCounts[type];
+}
+
+void printResourceCounts(FILE *out) {
+	int i;
+	fprintf(out, "live server resources:");
+	for (i = 0; i < ResourceTypeCount; i++) {
+		fprintf(out, " %s=%lu", resourceNames[i], liveCounts[i]);
+	}
+	fprintf(out, "\n");
+}
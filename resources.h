@@ -0,0 +1,62 @@
+/*
+ * Copyright (c) 2012 Daniel Loffgren
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef classic_wm_resources_h
+#define classic_wm_resources_h
+
+#include <stdio.h>
+#include <X11/Xlib.h>
+
+/*
+ * Server side objects that are created once per screen and shared by every
+ * frame, instead of being created (and leaked) per event or per window.
+ */
+struct ScreenResources_t {
+	GC gc;
+	GC outlineGC;    /* XOR on the root, through every window on it */
+	XFontStruct *font;
+	Cursor cursor;
+	int advances[256];    /* of each character in font, so titles are measured without Xlib */
+	unsigned long white;
+	unsigned long black;
+};
+
+typedef struct ScreenResources_t ScreenResources;
+
+typedef enum {
+	ResourceTypeGC = 0,
+	ResourceTypeFont,
+	ResourceTypeCursor,
+	ResourceTypePixmap,
+	ResourceTypeBackBuffer,
+	ResourceTypeCount
+} ResourceType;
+
+ScreenResources *resourcesForScreen(Display *display, int screen);
+void releaseAllResources(Display *display);
+
+/* Live server resource bookkeeping, so leaks show up as a growing count */
+void countResource(ResourceType type, int delta);
+unsigned long liveResourceCount(ResourceType type);
+void printResourceCounts(FILE *out);
+
+#endif
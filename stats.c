@@ -0,0 +1,294 @@
+/*
+ * Copyright (c) 2012 Daniel Loffgren
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/* sigaction() is POSIX, and hidden by -std=c89 otherwise */
+#define _POSIX_C_SOURCE 200112L
+
+#include <err.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "eventnames.h"
+#include "resources.h"
+#include "stats.h"
+#include "timing.h"
+
+/* Everything past the core protocol (XSync alarms, ...) shares the last slot */
+#define EVENT_SLOTS                (LASTEvent + 1)
+
+struct EventStats_t {
+	unsigned long count;
+	double total;
+	double worst;
+	unsigned long requests;
+	unsigned long roundTrips;
+	unsigned long histogram[STATS_HISTOGRAM_BUCKETS];
+};
+
+static int enabled;
+static Display *statsDisplay;
+static unsigned long firstRequest;
+static unsigned long allRoundTrips;
+static FILE *out;
+static double dumpInterval;
+static double nextDump;
+static double startTime;
+static volatile sig_atomic_t dumpRequested;
+
+static struct EventStats_t events[EVENT_SLOTS];
+static unsigned long counters[StatCount];
+static unsigned long dragSamples;
+static double dragTotal;
+static double dragWorst;
+static unsigned long dragExposeStart;    /* StatExposeReceived at the start of the drag */
+static int dragging;
+static unsigned long drags;
+static unsigned long dragExposes;
+static unsigned long dragExposesWorst;
+
+/* The event being handled */
+static int currentSlot;
+static double currentStart;
+static unsigned long currentRequest;
+static unsigned long roundTrips;
+static unsigned long lastSent;        /* the newest request at the last afterRequest() */
+
+static const char *counterNames[StatCount] = {
+	"expose received",
+	"expose painted",
+	"expose coalesced",
+	"frames",
+	"buffer swaps",
+	"errors on dead windows",
+	"other errors",
+};
+
+static void requestDump(int signal) {
+	(void)signal;
+	dumpRequested = 1;
+}
+
+/* Xlib calls this after every request, once it's installed */
+static int afterRequest(Display *display) {
+	const unsigned long processed = LastKnownRequestProcessed(display);
+	const unsigned long sent = NextRequest(display) - 1;
+
+	/*
+	 * Events read in between only vouch for requests sent before lastSent,
+	 * so the server having processed a newer one means we waited on its reply.
+	 */
+	if (processed == sent && (long)(sent - lastSent) > 0) {
+		roundTrips++;
+		allRoundTrips++;
+	}
+	lastSent = sent;
+	return 0;
+}
+
+void enableStats(Display *display, const char *path, double interval) {
+	struct sigaction action;
+
+	out = strcmp(path, "-") ? fopen(path, "a") : stderr;
+	if (!out) {
+		warn("unable to open stats file %s", path);
+		return;
+	}
+
+	memset(&action, 0, sizeof(action));
+	action.sa_handler = requestDump;
+	sigemptyset(&action.sa_mask);
+	sigaction(SIGUSR1, &action, NULL);
+
+	XSetAfterFunction(display, afterRequest);
+
+	enabled = 1;
+	statsDisplay = display;
+	firstRequest = NextRequest(display);
+	lastSent = firstRequest - 1;
+	startTime = currentTime();
+	dumpInterval = interval;
+	nextDump = interval > 0 ? startTime + interval : -1;
+}
+
+int statsEnabled(void) {
+	return enabled;
+}
+
+void beginEventStats(Display *display, int type) {
+	if (!enabled) {
+		return;
+	}
+
+	currentSlot = (type >= 0 && type < LASTEvent) ? type : LASTEvent;
+	currentRequest = NextRequest(display);
+	lastSent = NextRequest(display) - 1;
+	roundTrips = 0;
+	currentStart = currentTime();
+}
+
+void endEventStats(Display *display) {
+	struct EventStats_t *stats;
+	double elapsed;
+	unsigned long us;
+	int bucket = 0;
+
+	if (!enabled) {
+		return;
+	}
+
+	elapsed = currentTime() - currentStart;
+	stats = &events[currentSlot];
+	stats->count++;
+	stats->total += elapsed;
+	if (elapsed > stats->worst) {
+		stats->worst = elapsed;
+	}
+	stats->requests += NextRequest(display) - currentRequest;
+	stats->roundTrips += roundTrips;
+
+	for (us = (unsigned long)(elapsed * 1e6); us && bucket < STATS_HISTOGRAM_BUCKETS - 1; us >>= 1) {
+		bucket++;
+	}
+	stats->histogram[bucket]++;
+}
+
+void countStat(StatCounter counter) {
+	if (enabled) {
+		counters[counter]++;
+	}
+}
+
+void countDragLatency(double latency) {
+	if (!enabled) {
+		return;
+	}
+
+	dragSamples++;
+	dragTotal += latency;
+	if (latency > dragWorst) {
+		dragWorst = latency;
+	}
+}
+
+void beginDragStats(void) {
+	dragExposeStart = counters[StatExposeReceived];
+	dragging = 1;
+}
+
+void endDragStats(void) {
+	unsigned long exposes;
+
+	if (!dragging) {
+		return;
+	}
+
+	exposes = counters[StatExposeReceived] - dragExposeStart;
+	dragging = 0;
+	drags++;
+	dragExposes += exposes;
+	if (exposes > dragExposesWorst) {
+		dragExposesWorst = exposes;
+	}
+}
+
+double statsTimeout(double now) {
+	if (!enabled || nextDump < 0) {
+		return -1;
+	}
+	return nextDump > now ? nextDump - now : 0;
+}
+
+void dumpStats(ManagedWindowPool *pool, double now) {
+	unsigned long totalEvents = 0;
+	ManagedWindow *mw;
+	int i;
+	int j;
+
+	if (!enabled) {
+		return;
+	}
+
+	fprintf(out, "classic-wm stats after %.1fs\n", now - startTime);
+	fprintf(out, "%-18s %8s %9s %9s %9s %10s  histogram (us, <1 <2 <4 ...)\n",
+			"event", "count", "mean us", "worst us", "requests", "roundtrips");
+	for (i = 0; i < EVENT_SLOTS; i++) {
+		const struct EventStats_t *stats = &events[i];
+		if (!stats->count) {
+			continue;
+		}
+
+		fprintf(out, "%-18s %8lu %9.1f %9.1f %9lu %10lu ",
+				i < LASTEvent ? event_names[i] : "(extension)",
+				stats->count,
+				stats->total * 1e6 / stats->count,
+				stats->worst * 1e6,
+				stats->requests,
+				stats->roundTrips);
+		for (j = 0; j < STATS_HISTOGRAM_BUCKETS; j++) {
+			fprintf(out, " %lu", stats->histogram[j]);
+		}
+		fprintf(out, "\n");
+
+		totalEvents += stats->count;
+	}
+
+	/* A single line with the totals, including the flushes between events, for bench/benchclient */
+	fprintf(out, "total: events %lu requests %lu roundtrips %lu\n",
+			totalEvents, NextRequest(statsDisplay) - firstRequest, allRoundTrips);
+
+	for (i = 0; i < StatCount; i++) {
+		fprintf(out, "%s: %lu\n", counterNames[i], counters[i]);
+	}
+
+	if (dragSamples) {
+		fprintf(out, "drag latency: %lu frames, mean %.2fms, worst %.2fms\n",
+				dragSamples, dragTotal * 1000.0 / dragSamples, dragWorst * 1000.0);
+	}
+	if (drags) {
+		fprintf(out, "drag exposes: %lu drags, mean %.1f, worst %lu\n",
+				drags, (double)dragExposes / drags, dragExposesWorst);
+	}
+	printResourceCounts(out);
+
+	SLIST_FOREACH(mw, &pool->windows, entries) {
+		fprintf(out, "window 0x%lx \"%s\": %lu redraws\n", mw->actualWindow, mw->title ? mw->title : "", mw->redraws);
+	}
+	fprintf(out, "\n");
+	fflush(out);
+}
+
+void dumpStatsIfDue(ManagedWindowPool *pool, double now) {
+	if (!enabled) {
+		return;
+	}
+
+	if (dumpRequested) {
+		dumpRequested = 0;
+		dumpStats(pool, now);
+	}
+
+	if (nextDump >= 0 && now >= nextDump) {
+		dumpStats(pool, now);
+		nextDump = now + dumpInterval;
+	}
+}
@@ -0,0 +1,69 @@
+/*
+ * Copyright (c) 2012 Daniel Loffgren
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef classic_wm_stats_h
+#define classic_wm_stats_h
+
+#include <X11/Xlib.h>
+
+#include "pool.h"
+
+/*
+ * Instrumentation of the main loop, off unless -s is given. While off,
+ * every entry point returns immediately.
+ *
+ * Requests are counted from Xlib's sequence numbers. A round trip is
+ * counted when a request has been processed by the time the Xlib call
+ * that sent it returns, which only waiting on its reply can do. Events
+ * read while polling don't count, they only report older requests.
+ */
+#define STATS_HISTOGRAM_BUCKETS    (20)    /* handling time in us, by powers of two */
+
+typedef enum {
+	StatExposeReceived = 0,
+	StatExposePainted,
+	StatExposeCoalesced,
+	StatFrames,
+	StatSwaps,
+	StatErrorsBuried,
+	StatErrorsOther,
+	StatCount
+} StatCounter;
+
+void enableStats(Display *display, const char *path, double interval);
+int statsEnabled(void);
+
+void beginEventStats(Display *display, int type);
+void endEventStats(Display *display);
+void countStat(StatCounter counter);
+void countDragLatency(double latency);
+
+/* Brackets an interactive drag, to count the Expose events it causes */
+void beginDragStats(void);
+void endDragStats(void);
+
+/* Seconds until the next periodic dump, or negative if none is scheduled */
+double statsTimeout(double now);
+void dumpStatsIfDue(ManagedWindowPool *pool, double now);
+void dumpStats(ManagedWindowPool *pool, double now);
+
+#endif
@@ -0,0 +1,145 @@
+/*
+ * Copyright (c) 2012 Daniel Loffgren
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <string.h>
+#include <X11/Xlib.h>
+#include <X11/extensions/sync.h>
+
+#include "atoms.h"
+#include "syncrequest.h"
+
+static int syncAvailable;
+static int syncEventBase;
+
+int initializeSyncRequests(Display *display) {
+	int errorBase;
+	int major;
+	int minor;
+
+	syncAvailable = XSyncQueryExtension(display, &syncEventBase, &errorBase) &&
+					XSyncInitialize(display, &major, &minor);
+	return syncAvailable;
+}
+
+void watchSyncCounter(Display *display, ManagedWindow *mw, XID counter, ManagedWindowPool *pool) {
+	XSyncAlarmAttributes values;
+
+	if (!syncAvailable || counter == None) {
+		return;
+	}
+
+	/* Inactive until the first request arms it with a value to wait for */
+	XSyncIntToValue(&mw->syncValue, 0);
+	mw->syncSeeded = 0;
+	values.trigger.counter = counter;
+	values.trigger.value_type = XSyncAbsolute;
+	values.trigger.wait_value = mw->syncValue;
+	values.trigger.test_type = XSyncPositiveComparison;
+	XSyncIntToValue(&values.delta, 0);
+	values.events = True;
+
+	mw->syncCounter = counter;
+	mw->syncAlarm = XSyncCreateAlarm(display, XSyncCACounter | XSyncCAValueType | XSyncCAValue |
+									 XSyncCATestType | XSyncCADelta | XSyncCAEvents, &values);
+	addResourceToPool(mw->syncAlarm, mw, pool);
+}
+
+void unwatchSyncCounter(Display *display, ManagedWindow *mw, ManagedWindowPool *pool) {
+	if (mw->syncAlarm != None) {
+		forgetResourceInPool(mw->syncAlarm, pool);
+		XSyncDestroyAlarm(display, mw->syncAlarm);
+		mw->syncAlarm = None;
+	}
+	mw->syncCounter = None;
+	mw->syncPending = 0;
+}
+
+int clientMayResize(const ManagedWindow *mw, double now) {
+	/* An unanswered request also ends at clientResizeDue, in case the client hung */
+	return now >= mw->clientResizeDue;
+}
+
+void prepareClientResize(Display *display, ManagedWindow *mw, double now) {
+	XSyncAlarmAttributes values;
+	XSyncValue one;
+	XEvent ev;
+	Bool overflow;
+
+	if (mw->syncAlarm == None) {
+		mw->clientResizeDue = now + CLIENT_RESIZE_INTERVAL;
+		return;
+	}
+
+	/*
+	 * Counters outlive window managers, so requests count on from wherever
+	 * the client's is, or every alarm would fire as soon as it is armed.
+	 * Asked on the first resize, so that claiming a window costs no round trip.
+	 */
+	if (!mw->syncSeeded) {
+		XSyncValue current;
+
+		if (XSyncQueryCounter(display, mw->syncCounter, &current)) {
+			mw->syncValue = current;
+		}
+		mw->syncSeeded = 1;
+	}
+
+	XSyncIntToValue(&one, 1);
+	XSyncValueAdd(&mw->syncValue, mw->syncValue, one, &overflow);
+
+	/* Arm the alarm before asking, so that the answer can't be missed */
+	values.trigger.wait_value = mw->syncValue;
+	XSyncChangeAlarm(display, mw->syncAlarm, XSyncCAValue, &values);
+
+	memset(&ev, 0, sizeof(ev));
+	ev.xclient.type = ClientMessage;
+	ev.xclient.window = mw->actualWindow;
+	ev.xclient.message_type = atomNamed(AtomWMProtocols);
+	ev.xclient.format = 32;
+	ev.xclient.data.l[0] = atomNamed(AtomNetWMSyncRequest);
+	ev.xclient.data.l[1] = CurrentTime;
+	ev.xclient.data.l[2] = XSyncValueLow32(mw->syncValue);
+	ev.xclient.data.l[3] = XSyncValueHigh32(mw->syncValue);
+	XSendEvent(display, mw->actualWindow, False, NoEventMask, &ev);
+
+	mw->syncPending = 1;
+	mw->clientResizeDue = now + SYNC_REQUEST_TIMEOUT;
+}
+
+int handleSyncEvent(const XEvent *event, ManagedWindowPool *pool) {
+	const XSyncAlarmNotifyEvent *notify = (const XSyncAlarmNotifyEvent *)event;
+	ManagedWindow *mw;
+
+	if (!syncAvailable || event->type != syncEventBase + XSyncAlarmNotify) {
+		return 0;
+	}
+
+	/* Alarms are indexed along with their window's XIDs */
+	mw = managedWindowForWindow(notify->alarm, pool);
+	if (mw && mw->syncAlarm == notify->alarm && mw->syncPending) {
+		/* Repainted at the last size, so the next one can go out right away */
+		mw->syncPending = 0;
+		mw->clientResizeDue = 0;
+	}
+
+	return 1;
+}
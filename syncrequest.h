@@ -0,0 +1,51 @@
+/*
+ * Copyright (c) 2012 Daniel Loffgren
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef classic_wm_syncrequest_h
+#define classic_wm_syncrequest_h
+
+#include <X11/Xlib.h>
+
+#include "pool.h"
+
+/*
+ * _NET_WM_SYNC_REQUEST: before each interactive resize the client is told a
+ * counter value, and sets its counter to it once it has repainted at the new
+ * size. The next size is held back until then, so slow clients get fewer,
+ * newer sizes instead of a backlog of stale ones. Clients without the
+ * protocol are resized at most every CLIENT_RESIZE_INTERVAL instead.
+ */
+#define CLIENT_RESIZE_INTERVAL     (1.0 / 30)  /* seconds, without the protocol */
+#define SYNC_REQUEST_TIMEOUT       (0.5)       /* seconds, before giving up on an answer */
+
+/* Returns whether the XSync extension is there, without it every client is throttled */
+int initializeSyncRequests(Display *display);
+void watchSyncCounter(Display *display, ManagedWindow *mw, XID counter, ManagedWindowPool *pool);
+void unwatchSyncCounter(Display *display, ManagedWindow *mw, ManagedWindowPool *pool);
+
+int clientMayResize(const ManagedWindow *mw, double now);
+void prepareClientResize(Display *display, ManagedWindow *mw, double now);
+
+/* Returns whether the event was an alarm meant for us, acknowledging its window */
+int handleSyncEvent(const XEvent *event, ManagedWindowPool *pool);
+
+#endif
@@ -0,0 +1,58 @@
+/*
+ * Copyright (c) 2012 Daniel Loffgren
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+/* clock_gettime() and poll() are POSIX, and hidden by -std=c89 otherwise */
+#define _POSIX_C_SOURCE 200112L
+
+#include <errno.h>
+#include <poll.h>
+#include <time.h>
+
+#include "timing.h"
+
+double currentTime(void) {
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (double)now.tv_sec + (double)now.tv_nsec / 1e9;
+}
+
+int waitForDisplay(Display *display, double timeout) {
+	struct pollfd fd;
+
+	/* Anything Xlib already read off the socket won't wake poll() */
+	if (XPending(display)) {
+		return 1;
+	}
+
+	fd.fd = ConnectionNumber(display);
+	fd.events = POLLIN;
+	fd.revents = 0;
+
+	if (poll(&fd, 1, timeout < 0 ? -1 : (int)(timeout * 1000.0 + 0.5)) < 0) {
+		/* Signals just wake us up early */
+		return errno == EINTR ? 0 : -1;
+	}
+
+	return fd.revents & POLLIN;
+}
@@ -0,0 +1,134 @@
+/*
+ * Copyright (c) 2012 Daniel Loffgren
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <err.h>
+#include <X11/Xlib.h>
+
+#include "stats.h"
+#include "tombstone.h"
+
+#define GRAVE_NONE                 (-1)
+
+typedef struct {
+	Window window;             /* None once reused or exhumed */
+	unsigned long serial;
+	int next;                  /* in its bucket, or GRAVE_NONE */
+} Grave;
+
+static Grave graves[TOMBSTONE_CAPACITY];
+static int buckets[TOMBSTONE_CAPACITY];
+static unsigned int nextGrave;
+static int initialized;
+
+static unsigned int bucketForWindow(Window window) {
+	/* XIDs from one client only differ in their low bits, so fold the high ones in */
+	return (unsigned int)((window ^ (window >> 10) ^ (window >> 20)) & (TOMBSTONE_CAPACITY - 1));
+}
+
+static void initializeGraves(void) {
+	int i;
+	for (i = 0; i < TOMBSTONE_CAPACITY; i++) {
+		buckets[i] = GRAVE_NONE;
+		graves[i].window = None;
+		graves[i].next = GRAVE_NONE;
+	}
+	initialized = 1;
+}
+
+/* Returns the grave's slot, after unlinking it if remove is set, or GRAVE_NONE */
+static int findGrave(Window window, int remove) {
+	int *link;
+
+	if (!initialized) {
+		return GRAVE_NONE;
+	}
+
+	for (link = &buckets[bucketForWindow(window)]; *link != GRAVE_NONE; link = &graves[*link].next) {
+		const int slot = *link;
+		if (graves[slot].window == window) {
+			if (remove) {
+				*link = graves[slot].next;
+				graves[slot].window = None;
+				graves[slot].next = GRAVE_NONE;
+			}
+			return slot;
+		}
+	}
+	return GRAVE_NONE;
+}
+
+void buryWindow(Window window, unsigned long serial) {
+	const int slot = nextGrave++ & (TOMBSTONE_CAPACITY - 1);
+	unsigned int bucket;
+
+	if (!initialized) {
+		initializeGraves();
+	}
+
+	/* A window is only ever in one grave, and the oldest grave makes way */
+	findGrave(window, 1);
+	if (graves[slot].window != None) {
+		findGrave(graves[slot].window, 1);
+	}
+
+	bucket = bucketForWindow(window);
+	graves[slot].window = window;
+	graves[slot].serial = serial;
+	graves[slot].next = buckets[bucket];
+	buckets[bucket] = slot;
+}
+
+void exhumeWindow(Window window) {
+	findGrave(window, 1);
+}
+
+int windowIsBuried(Window window) {
+	return window != None && findGrave(window, 0) != GRAVE_NONE;
+}
+
+static int survivableError(Display *display, XErrorEvent *error) {
+	const int slot = findGrave(error->resourceid, 0);
+	char text[128];
+
+	/* Whatever we sent at or after the window's death is expected to fail */
+	if (slot != GRAVE_NONE && error->serial >= graves[slot].serial) {
+		countStat(StatErrorsBuried);
+		return 0;
+	}
+
+	countStat(StatErrorsOther);
+
+	/* Clients vanish between any two of our requests, that alone isn't worth a word */
+#ifndef DEBUG
+	if (error->error_code == BadWindow || error->error_code == BadDrawable) {
+		return 0;
+	}
+#endif
+
+	XGetErrorText(display, error->error_code, text, sizeof(text));
+	warnx("%s for request %d.%d on 0x%lx", text, error->request_code, error->minor_code, error->resourceid);
+	return 0;
+}
+
+void installErrorHandler(void) {
+	XSetErrorHandler(survivableError);
+}
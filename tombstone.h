@@ -0,0 +1,46 @@
+/*
+ * Copyright (c) 2012 Daniel Loffgren
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef classic_wm_tombstone_h
+#define classic_wm_tombstone_h
+
+#include <X11/Xlib.h>
+
+/*
+ * Recently destroyed windows, so that the events still on their way for
+ * them are dropped, and the errors from requests that raced their death
+ * are expected rather than fatal. Each grave is tagged with the serial
+ * from which requests on the window may fail. Graves are reused oldest
+ * first, which at TOMBSTONE_CAPACITY outlives any event still in flight,
+ * even with thousands of windows coming and going a minute.
+ */
+#define TOMBSTONE_CAPACITY         (1024)    /* a power of two */
+
+void buryWindow(Window window, unsigned long serial);
+/* For an XID that comes back as a new window */
+void exhumeWindow(Window window);
+int windowIsBuried(Window window);
+
+/* Replaces Xlib's error handler, which exits, with one that counts and carries on */
+void installErrorHandler(void);
+
+#endif
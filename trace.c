@@ -0,0 +1,578 @@
+/*
+ * Copyright (c) 2012 Daniel Loffgren
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <err.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <X11/Xatom.h> /* XA_LAST_PREDEFINED */
+
+#include "timing.h"
+#include "trace.h"
+
+#define TRACE_MAGIC                "CWMT"
+#define TRACE_VERSION              (1)
+#define MAPPING_BUCKETS            (1024)    /* power of two */
+#define SURROGATE_SIZE             (100)     /* for windows the trace never saw created */
+
+/*
+ * Everything is little endian. The header is the magic, the version, the
+ * size of an XEvent, and the root window. Every record starts with its type
+ * and the microseconds since the record before it:
+ *
+ *   event, coalesced   length:16 XEvent:length
+ *   claim              window:32 frame:32 resizer:32 x:16 y:16 width:16 height:16 border:16 length:16 title:length
+ *   atom               atom:32 length:16 name:length
+ */
+
+/* Recorded XIDs, and what stands in for them on the replay server */
+struct Mapping_t {
+	XID recorded;
+	XID replayed;
+	int surrogate;             /* created by the replay, so it's ours to map and destroy */
+	struct Mapping_t *next;
+};
+
+static FILE *trace;
+static double lastTime;
+static Window recordedRoot;
+static struct Mapping_t *windows[MAPPING_BUCKETS];
+static struct Mapping_t *atoms[MAPPING_BUCKETS];
+
+/* Replay */
+static double replayTime;
+static TraceRecord lookahead;
+static int haveLookahead;
+
+static struct Mapping_t *findMapping(struct Mapping_t **table, XID recorded) {
+	struct Mapping_t *mapping;
+	for (mapping = table[recorded & (MAPPING_BUCKETS - 1)]; mapping; mapping = mapping->next) {
+		if (mapping->recorded == recorded) {
+			return mapping;
+		}
+	}
+	return NULL;
+}
+
+static struct Mapping_t *addMapping(struct Mapping_t **table, XID recorded, XID replayed) {
+	struct Mapping_t *mapping = findMapping(table, recorded);
+
+	if (!mapping) {
+		struct Mapping_t **bucket = &table[recorded & (MAPPING_BUCKETS - 1)];
+		mapping = calloc(1, sizeof(struct Mapping_t));
+		if (!mapping) {
+			err(1, "unable to allocate trace mapping");
+		}
+		mapping->recorded = recorded;
+		mapping->next = *bucket;
+		*bucket = mapping;
+	}
+	mapping->replayed = replayed;
+	mapping->surrogate = 0;
+
+	return mapping;
+}
+
+static void releaseMappings(struct Mapping_t **table) {
+	unsigned int i;
+	for (i = 0; i < MAPPING_BUCKETS; i++) {
+		while (table[i]) {
+			struct Mapping_t *dead = table[i];
+			table[i] = dead->next;
+			free(dead);
+		}
+	}
+}
+
+static void putU8(unsigned int value) {
+	fputc(value & 0xff, trace);
+}
+
+static void putU16(unsigned int value) {
+	putU8(value);
+	putU8(value >> 8);
+}
+
+static void putU32(unsigned long value) {
+	putU16(value & 0xffff);
+	putU16((value >> 16) & 0xffff);
+}
+
+static void putString(const char *string, unsigned int max) {
+	const size_t length = string ? strlen(string) : 0;
+	const unsigned int clipped = length < max ? length : max;
+
+	putU16(clipped);
+	fwrite(string, 1, clipped, trace);
+}
+
+static int getU8(unsigned int *value) {
+	const int c = fgetc(trace);
+	*value = c;
+	return c != EOF;
+}
+
+static int getU16(unsigned int *value) {
+	unsigned int low;
+	unsigned int high;
+
+	if (!getU8(&low) || !getU8(&high)) {
+		return 0;
+	}
+	*value = low | (high << 8);
+	return 1;
+}
+
+static int getU32(unsigned long *value) {
+	unsigned int low;
+	unsigned int high;
+
+	if (!getU16(&low) || !getU16(&high)) {
+		return 0;
+	}
+	*value = low | ((unsigned long)high << 16);
+	return 1;
+}
+
+static int getString(char *string, unsigned int size) {
+	unsigned int length;
+
+	if (!getU16(&length) || length >= size || fread(string, 1, length, trace) != length) {
+		return 0;
+	}
+	string[length] = '\0';
+	return 1;
+}
+
+/* Only the part of the union that this type uses is worth writing */
+static unsigned int eventLength(int type) {
+	switch (type) {
+		case KeyPress:
+		case KeyRelease:           return sizeof(XKeyEvent);
+		case ButtonPress:
+		case ButtonRelease:        return sizeof(XButtonEvent);
+		case MotionNotify:         return sizeof(XMotionEvent);
+		case EnterNotify:
+		case LeaveNotify:          return sizeof(XCrossingEvent);
+		case FocusIn:
+		case FocusOut:             return sizeof(XFocusChangeEvent);
+		case Expose:               return sizeof(XExposeEvent);
+		case CreateNotify:         return sizeof(XCreateWindowEvent);
+		case DestroyNotify:        return sizeof(XDestroyWindowEvent);
+		case UnmapNotify:          return sizeof(XUnmapEvent);
+		case MapNotify:            return sizeof(XMapEvent);
+		case MapRequest:           return sizeof(XMapRequestEvent);
+		case ReparentNotify:       return sizeof(XReparentEvent);
+		case ConfigureNotify:      return sizeof(XConfigureEvent);
+		case ConfigureRequest:     return sizeof(XConfigureRequestEvent);
+		case PropertyNotify:       return sizeof(XPropertyEvent);
+		case ClientMessage:        return sizeof(XClientMessageEvent);
+		default:                   return sizeof(XEvent);
+	}
+}
+
+static void writeRecordHeader(TraceRecordType type) {
+	const double now = currentTime();
+	const double delta = (now - lastTime) * 1e6;
+
+	lastTime = now;
+	putU8(type);
+	putU32(delta < 0xffffffffUL ? (unsigned long)delta : 0xffffffffUL);
+}
+
+int startTraceRecording(Display *display, const char *path, Window root) {
+	(void)display;
+
+	trace = fopen(path, "wb");
+	if (!trace) {
+		warn("unable to open trace file %s", path);
+		return 0;
+	}
+
+	fwrite(TRACE_MAGIC, 1, strlen(TRACE_MAGIC), trace);
+	putU16(TRACE_VERSION);
+	putU16(sizeof(XEvent));
+	putU32(root);
+	lastTime = currentTime();
+
+	return 1;
+}
+
+/* Atoms are only meaningful to the server that interned them, so names go in the trace once */
+static void traceAtom(Display *display, Atom atom) {
+	char *name;
+
+	if (atom <= XA_LAST_PREDEFINED || findMapping(atoms, atom)) {
+		return;
+	}
+
+	name = XGetAtomName(display, atom);
+	if (name) {
+		writeRecordHeader(TraceRecordAtom);
+		putU32(atom);
+		putString(name, TRACE_TITLE_MAX - 1);
+		XFree(name);
+	}
+	addMapping(atoms, atom, atom);
+}
+
+void traceEvent(Display *display, const XEvent *event, int coalesced) {
+	if (!trace) {
+		return;
+	}
+
+	if (event->type == PropertyNotify) {
+		traceAtom(display, event->xproperty.atom);
+	}
+	else if (event->type == ClientMessage) {
+		traceAtom(display, event->xclient.message_type);
+	}
+
+	writeRecordHeader(coalesced ? TraceRecordCoalesced : TraceRecordEvent);
+	putU16(eventLength(event->type));
+	fwrite(event, 1, eventLength(event->type), trace);
+}
+
+void traceClaim(const ClaimInfo *info, Window frame, Window resizer) {
+	if (!trace) {
+		return;
+	}
+
+	writeRecordHeader(TraceRecordClaim);
+	putU32(info->window);
+	putU32(frame);
+	putU32(resizer);
+	putU16(info->x);
+	putU16(info->y);
+	putU16(info->width);
+	putU16(info->height);
+	putU16(info->border_width);
+	putString(info->title, TRACE_TITLE_MAX - 1);
+}
+
+void flushTrace(void) {
+	if (trace) {
+		fflush(trace);
+	}
+}
+
+void stopTraceRecording(void) {
+	if (trace) {
+		fclose(trace);
+		trace = NULL;
+	}
+	releaseMappings(atoms);
+}
+
+int startTraceReplay(Display *display, const char *path, Window root) {
+	char magic[sizeof(TRACE_MAGIC)];
+	unsigned int version;
+	unsigned int eventSize;
+	unsigned long recorded;
+	(void)display;
+
+	trace = fopen(path, "rb");
+	if (!trace) {
+		warn("unable to open trace file %s", path);
+		return 0;
+	}
+
+	memset(magic, 0, sizeof(magic));
+	if (fread(magic, 1, strlen(TRACE_MAGIC), trace) != strlen(TRACE_MAGIC) || strcmp(magic, TRACE_MAGIC) ||
+		!getU16(&version) || !getU16(&eventSize) || !getU32(&recorded)) {
+		warnx("%s is not a trace", path);
+		stopTraceReplay();
+		return 0;
+	}
+	if (version != TRACE_VERSION || eventSize != sizeof(XEvent)) {
+		warnx("%s was recorded by another version or architecture", path);
+		stopTraceReplay();
+		return 0;
+	}
+
+	recordedRoot = recorded;
+	addMapping(windows, recordedRoot, root);
+	replayTime = 0;
+	haveLookahead = 0;
+
+	return 1;
+}
+
+/* Reads the next record as it was written, without mapping anything */
+static int readRawRecord(TraceRecord *record) {
+	unsigned int type;
+	unsigned long delta;
+
+	if (haveLookahead) {
+		*record = lookahead;
+		haveLookahead = 0;
+		return 1;
+	}
+
+	if (!getU8(&type) || !getU32(&delta)) {
+		return 0;
+	}
+	replayTime += delta / 1e6;
+	record->type = type;
+	record->time = replayTime;
+
+	switch (type) {
+		case TraceRecordEvent:
+		case TraceRecordCoalesced: {
+			unsigned int length;
+			memset(&record->event, 0, sizeof(XEvent));
+			return getU16(&length) && length <= sizeof(XEvent) && fread(&record->event, 1, length, trace) == length;
+		}
+		case TraceRecordClaim: {
+			unsigned long window;
+			unsigned long frame;
+			unsigned long resizer;
+			unsigned int x;
+			unsigned int y;
+
+			if (!getU32(&window) || !getU32(&frame) || !getU32(&resizer) || !getU16(&x) || !getU16(&y) ||
+				!getU16(&record->width) || !getU16(&record->height) || !getU16(&record->border_width)) {
+				return 0;
+			}
+			record->window = window;
+			record->frame = frame;
+			record->resizer = resizer;
+			record->x = (short)x;
+			record->y = (short)y;
+			return getString(record->title, sizeof(record->title));
+		}
+		case TraceRecordAtom: {
+			unsigned long atom;
+			if (!getU32(&atom)) {
+				return 0;
+			}
+			/* Never handed out, so the claim fields carry the atom and its name */
+			record->window = atom;
+			return getString(record->title, sizeof(record->title));
+		}
+		default:
+			warnx("unknown trace record type %u", type);
+			return 0;
+	}
+}
+
+static Window createWindow(Display *display, Window recorded, int x, int y, unsigned int width, unsigned int height, unsigned int border_width, Bool overrideRedirect, const char *title) {
+	XSetWindowAttributes attributes;
+	Window window;
+
+	attributes.override_redirect = overrideRedirect;
+	window = XCreateWindow(display, replayedWindow(recordedRoot), x, y, width ? width : 1, height ? height : 1, border_width,
+						   CopyFromParent, InputOutput, (Visual *)CopyFromParent, CWOverrideRedirect, &attributes);
+	if (title && *title) {
+		XStoreName(display, window, title);
+	}
+	addMapping(windows, recorded, window)->surrogate = 1;
+
+	return window;
+}
+
+static Atom replayedAtom(Atom recorded) {
+	const struct Mapping_t *mapping;
+
+	if (recorded <= XA_LAST_PREDEFINED) {
+		return recorded;
+	}
+	mapping = findMapping(atoms, recorded);
+	return mapping ? mapping->replayed : None;
+}
+
+/*
+ * Plays what the clients did on the replay server, so that what the window
+ * manager asks of it afterwards finds things the way they were.
+ */
+static void replayClients(Display *display, const XEvent *event) {
+	struct Mapping_t *mapping;
+
+	switch (event->type) {
+		case CreateNotify:
+			if (event->xcreatewindow.parent == recordedRoot && !findMapping(windows, event->xcreatewindow.window)) {
+				createWindow(display, event->xcreatewindow.window, event->xcreatewindow.x, event->xcreatewindow.y,
+							 event->xcreatewindow.width, event->xcreatewindow.height, event->xcreatewindow.border_width,
+							 event->xcreatewindow.override_redirect, NULL);
+			}
+			break;
+		case MapNotify:
+			if (event->xmap.event == recordedRoot && !findMapping(windows, event->xmap.window)) {
+				createWindow(display, event->xmap.window, 0, 0, SURROGATE_SIZE, SURROGATE_SIZE, 0, event->xmap.override_redirect, NULL);
+			}
+			mapping = findMapping(windows, event->xmap.window);
+			if (mapping && mapping->surrogate) {
+				XMapWindow(display, mapping->replayed);
+			}
+			break;
+		case DestroyNotify:
+			mapping = findMapping(windows, event->xdestroywindow.window);
+			if (mapping && mapping->surrogate) {
+				XDestroyWindow(display, mapping->replayed);
+				mapping->surrogate = 0;
+			}
+			break;
+	}
+}
+
+/* Returns 0 for events that can't be replayed */
+static int mapEvent(Display *display, XEvent *event) {
+	/* Extension events (XSync alarms) refer to counters that the surrogates don't have */
+	if (event->type < KeyPress || event->type >= LASTEvent) {
+		return 0;
+	}
+
+	replayClients(display, event);
+	event->xany.display = display;
+
+	switch (event->type) {
+		case KeyPress:
+		case KeyRelease:
+			event->xkey.root = replayedWindow(event->xkey.root);
+			event->xkey.subwindow = replayedWindow(event->xkey.subwindow);
+			break;
+		case ButtonPress:
+		case ButtonRelease:
+			event->xbutton.root = replayedWindow(event->xbutton.root);
+			event->xbutton.subwindow = replayedWindow(event->xbutton.subwindow);
+			break;
+		case MotionNotify:
+			event->xmotion.root = replayedWindow(event->xmotion.root);
+			event->xmotion.subwindow = replayedWindow(event->xmotion.subwindow);
+			break;
+		case EnterNotify:
+		case LeaveNotify:
+			event->xcrossing.root = replayedWindow(event->xcrossing.root);
+			event->xcrossing.subwindow = replayedWindow(event->xcrossing.subwindow);
+			break;
+		case CreateNotify:
+			event->xcreatewindow.window = replayedWindow(event->xcreatewindow.window);
+			break;
+		case DestroyNotify:
+			event->xdestroywindow.window = replayedWindow(event->xdestroywindow.window);
+			break;
+		case UnmapNotify:
+			event->xunmap.window = replayedWindow(event->xunmap.window);
+			break;
+		case MapNotify:
+			event->xmap.window = replayedWindow(event->xmap.window);
+			break;
+		case MapRequest:
+			event->xmaprequest.window = replayedWindow(event->xmaprequest.window);
+			break;
+		case ReparentNotify:
+			event->xreparent.window = replayedWindow(event->xreparent.window);
+			event->xreparent.parent = replayedWindow(event->xreparent.parent);
+			break;
+		case ConfigureNotify:
+			event->xconfigure.window = replayedWindow(event->xconfigure.window);
+			event->xconfigure.above = replayedWindow(event->xconfigure.above);
+			break;
+		case ConfigureRequest:
+			event->xconfigurerequest.window = replayedWindow(event->xconfigurerequest.window);
+			event->xconfigurerequest.above = replayedWindow(event->xconfigurerequest.above);
+			break;
+		case PropertyNotify:
+			event->xproperty.atom = replayedAtom(event->xproperty.atom);
+			break;
+		case ClientMessage:
+			event->xclient.message_type = replayedAtom(event->xclient.message_type);
+			break;
+	}
+
+	/* Every event's first window (event, parent, ...) lines up with xany.window */
+	event->xany.window = replayedWindow(event->xany.window);
+
+	return 1;
+}
+
+int readTraceRecord(Display *display, TraceRecord *record) {
+	while (readRawRecord(record)) {
+		switch (record->type) {
+			case TraceRecordAtom:
+				addMapping(atoms, record->window, XInternAtom(display, record->title, False));
+				break;
+			case TraceRecordClaim:
+				return 1;
+			default:
+				/* A coalesced event whose motion was dropped just gets handled on its own */
+				if (mapEvent(display, &record->event)) {
+					return 1;
+				}
+				break;
+		}
+	}
+
+	return 0;
+}
+
+int readCoalescedEvent(Display *display, XEvent *event) {
+	if (!haveLookahead) {
+		if (!readRawRecord(&lookahead)) {
+			return 0;
+		}
+		haveLookahead = 1;
+	}
+
+	if (lookahead.type != TraceRecordCoalesced) {
+		return 0;
+	}
+
+	haveLookahead = 0;
+	*event = lookahead.event;
+	return mapEvent(display, event);
+}
+
+Window replayedWindow(Window recorded) {
+	const struct Mapping_t *mapping;
+
+	if (recorded == None) {
+		return None;
+	}
+	mapping = findMapping(windows, recorded);
+	return mapping ? mapping->replayed : None;
+}
+
+void mapReplayedWindow(Window recorded, Window replayed) {
+	addMapping(windows, recorded, replayed);
+}
+
+Window createSurrogateWindow(Display *display, const TraceRecord *record) {
+	Window window = replayedWindow(record->window);
+
+	if (!window) {
+		window = createWindow(display, record->window, record->x, record->y, record->width, record->height,
+							  record->border_width, False, record->title);
+	}
+	XMapWindow(display, window);
+
+	return window;
+}
+
+void stopTraceReplay(void) {
+	if (trace) {
+		fclose(trace);
+		trace = NULL;
+	}
+	releaseMappings(windows);
+	releaseMappings(atoms);
+}
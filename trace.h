@@ -0,0 +1,86 @@
+/*
+ * Copyright (c) 2012 Daniel Loffgren
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef classic_wm_trace_h
+#define classic_wm_trace_h
+
+#include <X11/Xlib.h>
+
+#include "claim.h"
+
+/*
+ * Event traces, see -t and -R. A trace holds every event the main loop was
+ * handed, with the time it arrived, plus enough about each claimed window to
+ * stand a surrogate in for it later. Events are stored as Xlib hands them
+ * over, so a trace only replays on the architecture that recorded it.
+ *
+ * Replay maps every recorded window and atom onto its counterpart on the
+ * replay server. Anything that can't be mapped comes back as None.
+ */
+#define TRACE_TITLE_MAX            (256)
+
+typedef enum {
+	TraceRecordEvent = 1,
+	TraceRecordCoalesced,      /* folded into the event before it by handleEvent() */
+	TraceRecordClaim,
+	TraceRecordAtom
+} TraceRecordType;
+
+typedef struct {
+	int type;
+	double time;               /* seconds since the trace started */
+	XEvent event;
+
+	/* TraceRecordClaim, as recorded */
+	Window window;
+	Window frame;
+	Window resizer;
+	int x;
+	int y;
+	unsigned int width;
+	unsigned int height;
+	unsigned int border_width;
+	char title[TRACE_TITLE_MAX];
+} TraceRecord;
+
+int startTraceRecording(Display *display, const char *path, Window root);
+void traceEvent(Display *display, const XEvent *event, int coalesced);
+void traceClaim(const ClaimInfo *info, Window frame, Window resizer);
+void flushTrace(void);
+void stopTraceRecording(void);
+
+int startTraceReplay(Display *display, const char *path, Window root);
+
+/* Returns 0 at the end of the trace. Only events and claims come back, events already mapped. */
+int readTraceRecord(Display *display, TraceRecord *record);
+
+/* Takes the next record only if it was coalesced into the event just read */
+int readCoalescedEvent(Display *display, XEvent *event);
+
+Window replayedWindow(Window recorded);
+void mapReplayedWindow(Window recorded, Window replayed);
+
+/* Stands a window in for the one a claim record was for, mapped and ready to be claimed */
+Window createSurrogateWindow(Display *display, const TraceRecord *record);
+void stopTraceReplay(void);
+
+#endif